@@ -12,6 +12,7 @@
 
 IRGenerator *Node::irgen = new IRGenerator();
 SymbolTable *Node::symbolTable = new SymbolTable(irgen);
+SymbolTable *Node::constTable = new SymbolTable(irgen);
 std::vector<llvm::BasicBlock *> Node::bbStack;
 std::vector<llvm::BasicBlock *> Node::bbLoopExitStack;
 std::vector<llvm::BasicBlock *> Node::bbContinueStack;
@@ -33,6 +34,11 @@ llvm::Value* Node::Emit()
 	 return llvm::UndefValue::get(irgen->GetVoidType());
 }
 
+void Node::Walk(NodeVisitor *visitor) {
+    visitor->Visit(this);
+    WalkChildren(visitor);
+}
+
 /* The Print method is used to print the parse tree nodes.
  * If this node has a location (most nodes do, but some do not), it
  * will first print the line number to help you match the parse tree 
@@ -47,6 +47,16 @@ using namespace std;
 class SymbolTable;
 class MyStack;
 class FnDecl;
+class Node;
+
+// Walk() calls Visit() on a node and then on every declaration, statement
+// and expression below it, parents before children
+class NodeVisitor
+{
+  public:
+    virtual ~NodeVisitor() {}
+    virtual void Visit(Node *node) = 0;
+};
 
 class Node  {
   protected:
@@ -54,6 +64,7 @@ class Node  {
     Node *parent;
 
 	static SymbolTable *symbolTable;	//keeps tracks of scope tables
+	static SymbolTable *constTable;		//values of const variables, used by FoldConstants
 	static IRGenerator *irgen;
 	static std::vector<llvm::BasicBlock *> bbStack;
 	static std::vector<llvm::BasicBlock *> bbLoopExitStack;
@@ -77,6 +88,15 @@ class Node  {
     void Print(int indentLevel, const char *label = NULL); 
     virtual void PrintChildren(int indentLevel)  {}
 
+    // same for Walk(), subclasses override WalkChildren()
+    void Walk(NodeVisitor *visitor);
+    virtual void WalkChildren(NodeVisitor *visitor)  {}
+
+    // compile-time evaluation, run over the whole tree before Emit():
+    // constant subexpressions are replaced by their values and reads of
+    // const variables by the value of their initializer
+    virtual void FoldConstants() {}
+
     virtual llvm::Value* Emit();
 };
    
@@ -20,14 +20,20 @@ llvm::Value* Decl::Emit()
 VarDecl::VarDecl(Identifier *n, Type *t, Expr *e) : Decl(n) {
     Assert(n != NULL && t != NULL);
     (type=t)->SetParent(this);
+    assignTo = NULL;
     if (e) (assignTo=e)->SetParent(this);
+    constValue = NULL;
+    initValue = NULL;
     typeq = NULL;
 }
 
 VarDecl::VarDecl(Identifier *n, TypeQualifier *tq, Expr *e) : Decl(n) {
     Assert(n != NULL && tq != NULL);
     (typeq=tq)->SetParent(this);
+    assignTo = NULL;
     if (e) (assignTo=e)->SetParent(this);
+    constValue = NULL;
+    initValue = NULL;
     type = NULL;
 }
 
@@ -35,7 +41,10 @@ VarDecl::VarDecl(Identifier *n, Type *t, TypeQualifier *tq, Expr *e) : Decl(n) {
     Assert(n != NULL && t != NULL && tq != NULL);
     (type=t)->SetParent(this);
     (typeq=tq)->SetParent(this);
+    assignTo = NULL;
     if (e) (assignTo=e)->SetParent(this);
+    constValue = NULL;
+    initValue = NULL;
 }
   
 void VarDecl::PrintChildren(int indentLevel) { 
@@ -45,13 +54,43 @@ void VarDecl::PrintChildren(int indentLevel) {
    if (assignTo) assignTo->Print(indentLevel+1, "(initializer) ");
 }
 
+void VarDecl::WalkChildren(NodeVisitor *visitor) {
+   if (assignTo) assignTo->Walk(visitor);
+}
+
+bool VarDecl::IsGlobal()
+{
+	return dynamic_cast<Program *>(GetParent()) != NULL;
+}
+
+void VarDecl::FoldConstants()
+{
+	//the initializer is folded before the name comes into scope
+	if(assignTo != NULL)
+	{
+		assignTo = Expr::Fold(assignTo);
+		if(typeq == TypeQualifier::constTypeQualifier)
+			constValue = assignTo->Evaluate();
+
+		//globals are initialized with data, there is no code to run it
+		if(IsGlobal())
+		{
+			initValue = assignTo->Evaluate();
+			if(initValue == NULL)
+				ReportError::Formatted(GetLocation(), "Initializer of global '%s' is not a constant expression", id->GetName());
+		}
+	}
+
+	//every declaration is entered, a non-const one hides outer constants
+	Symbol sym(id->GetName(), this, E_VarDecl, constValue);
+	constTable->insert(sym);
+}
+
 //EMIT
 llvm::Value* VarDecl::Emit()
 {
 
 
-	//current function we are in, if any
-	llvm::Function *func = irgen->GetFunction();
 	llvm::Module *mod = irgen->GetOrCreateModule("Module");
 	llvm::Type *llvmType;
 	llvm::Type *elmtType = NULL;
@@ -63,41 +102,48 @@ llvm::Value* VarDecl::Emit()
 		elmtType = arrayType->GetElemType()->typeToLlvmType();
 		llvmType =  llvm::ArrayType::get(elmtType, arrayType->GetElemCount());
 	}
-	else if(type->IsEquivalentTo(Type::intType))
-	{
-		llvmType = irgen->GetIntType();
-	}		
-	else if(type->IsEquivalentTo(Type::floatType))
-	{	
-		llvmType = irgen->GetFloatType();
-	}		
-	else if(type->IsEquivalentTo(Type::boolType))
-	{
-		llvmType = irgen->GetBoolType();
-	}	
-	else if(type->IsEquivalentTo(Type::vec2Type))
-	{
-		llvmType = irgen->GetVec2Type();
-	}		
-	else if(type->IsEquivalentTo(Type::vec3Type))
+	else
 	{
-		llvmType = irgen->GetVec3Type();
+		llvmType = type->typeToLlvmType();
 	}
-	else if(type->IsEquivalentTo(Type::vec4Type))
-	{		
-		llvmType = irgen->GetVec4Type();
+
+
+
+	//const with a compile-time value needs no storage, all reads were folded
+	if(constValue != NULL && !constValue->getType()->isAggregateType())
+	{
+		Symbol sym(id->GetName(), this, E_VarDecl, constValue, llvmType);
+		symbolTable->insert(sym);
+
+		return constValue;
 	}
 
+	//a const matrix or array is read-only data shared by all invocations,
+	//indexing it with a variable loads from it instead of rebuilding it
+	if(constValue != NULL)
+	{
+		llvm::GlobalVariable *data = new llvm::GlobalVariable(*mod, constValue->getType(), true,
+			llvm::GlobalValue::InternalLinkage, constValue, id->GetName());
+		data->setUnnamedAddr(true);
+
+		Symbol sym(id->GetName(), this, E_VarDecl, data, elmtType ? elmtType : llvmType);
+		symbolTable->insert(sym);
 
+		return data;
+	}
 
-	//Global variable if outside of function
-	if(func == NULL)
+	//Global variable if outside of function, decided like in FoldConstants
+	if(IsGlobal())
 	{	
 		//TODO check if constant or not
 		//create global var and add it to current global scope table
 
 		llvm::GlobalVariable *globalVar = llvm::cast<llvm::GlobalVariable>(mod->getOrInsertGlobal(id->GetName(), llvmType));
 		globalVar->setConstant(false);
+		if(initValue != NULL)
+			globalVar->setInitializer(initValue);
+		if(typeq == TypeQualifier::volatileTypeQualifier)
+			irgen->MarkVolatile(globalVar);
 
 		Symbol sym(id->GetName(), this, E_VarDecl, globalVar, elmtType ? elmtType : llvmType);
 		symbolTable->insert(sym);
@@ -106,11 +152,19 @@ llvm::Value* VarDecl::Emit()
 	}
 	else
 	{
-		//crete local var and add it to first Basic Block in func
-		llvm::Function::iterator b = func->begin();
-		llvm::BasicBlock *firstBB = b;
-
-		llvm::AllocaInst *var = new llvm::AllocaInst(llvmType, id->GetName(),  firstBB);
+		//initializer is evaluated before the name comes into scope
+		llvm::Value *init = NULL;
+		if(assignTo != NULL)
+		{
+			init = assignTo->Emit();
+			if(init->getType()->isPointerTy())
+				init = irgen->CreateLoad(init);
+		}
+
+		//create local var, kept in registers unless it needs memory
+		llvm::Value *var = irgen->CreateLocal(llvmType, id->GetName(), typeq == TypeQualifier::volatileTypeQualifier);
+		if(init != NULL)
+			irgen->CreateStore(init, var);
 
 		Symbol sym(id->GetName(), this, E_VarDecl, var, elmtType ? elmtType : llvmType);
 		symbolTable->insert(sym);
@@ -147,6 +201,28 @@ void FnDecl::PrintChildren(int indentLevel) {
     if (body) body->Print(indentLevel+1, "(body) ");
 }
 
+void FnDecl::WalkChildren(NodeVisitor *visitor) {
+    if (formals) formals->WalkAll(visitor);
+    if (body) body->Walk(visitor);
+}
+
+void FnDecl::FoldConstants()
+{
+	//entered before the body, calls by this name never fold to a built-in
+	Symbol sym(id->GetName(), this, E_FunctionDecl);
+	constTable->insert(sym);
+
+	constTable->push();
+
+	for(int i = 0; i < formals->NumElements(); i++)
+		formals->Nth(i)->FoldConstants();
+
+	if(body != NULL)
+		body->FoldConstants();
+
+	constTable->pop();
+}
+
 llvm::Value* FnDecl::Emit()
 {
 	symbolTable->push();
@@ -170,6 +246,7 @@ llvm::Value* FnDecl::Emit()
 	llvm::Module *mod = irgen->GetOrCreateModule("Module");
 	llvm::Function *func = llvm::cast<llvm::Function>(mod->getOrInsertFunction(id->GetName(), funcType));
 	irgen->SetFunction(func);
+	irgen->SetFloatSemantics(func, returnTypeq == TypeQualifier::preciseTypeQualifier);
 
 
 	//set func params name
@@ -181,41 +258,33 @@ llvm::Value* FnDecl::Emit()
 	}
 
 	
-	//insert entry block
+	//insert entry block, it only holds the stack slots
 	llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "entry", func);
 	irgen->SetBasicBlock(entryBB);
 
-	//allocate params
-	for(int i = 0; i < formals->NumElements(); i++)
-	{
-		VarDecl *decl = formals->Nth(i);
-		decl->Emit();		
-	}
-
 	//create new basic block
 	llvm::BasicBlock *nextBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "next", func);
+	irgen->GetBuilder()->CreateBr(nextBB);
+	irgen->SealBlock(entryBB);
+	irgen->SealBlock(nextBB);
 	irgen->SetBasicBlock(nextBB);
 
-	
-	//store params
-	llvm::BasicBlock::iterator inst = entryBB->begin();
+	//allocate and store params
 	arg = func->arg_begin();
-	for(int i = 0; i < formals->NumElements(); i++, inst++, arg++)
+	for(int i = 0; i < formals->NumElements(); i++, arg++)
 	{
-		//TODO Not sure about storing the argument into the allocation
-		llvm::StoreInst *store = new llvm::StoreInst(arg, inst, nextBB);
+		VarDecl *decl = formals->Nth(i);
+		irgen->CreateStore(arg, decl->Emit());
 	}
 
 	
 	body->Emit();
-	
-	//branch entry bb to next bb
-	llvm::BranchInst *branch = llvm::BranchInst::Create(nextBB, entryBB);
 
 
 	if(irgen->GetBasicBlock()->getTerminator() == NULL)
-		new llvm::UnreachableInst(*(irgen->GetContext()), irgen->GetBasicBlock());
+		irgen->GetBuilder()->CreateUnreachable();
 
+	irgen->FinishFunction();
 	symbolTable->pop();
 	
 	return llvm::UndefValue::get(irgen->GetVoidType());
@@ -52,15 +52,21 @@ class VarDecl : public Decl
     Type *type;
     TypeQualifier *typeq;
     Expr *assignTo;
+    llvm::Constant *constValue;	//value of a const variable, set by FoldConstants
+    llvm::Constant *initValue;	//initializer of a global, set by FoldConstants
     
   public:
-    VarDecl() : type(NULL), typeq(NULL), assignTo(NULL) {}
+    VarDecl() : type(NULL), typeq(NULL), assignTo(NULL), constValue(NULL), initValue(NULL) {}
     VarDecl(Identifier *name, Type *type, Expr *assignTo = NULL);
     VarDecl(Identifier *name, TypeQualifier *typeq, Expr *assignTo = NULL);
     VarDecl(Identifier *name, Type *type, TypeQualifier *typeq, Expr *assignTo = NULL);
     const char *GetPrintNameForNode() { return "VarDecl"; }
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
     Type *GetType() const { return type; }
+    TypeQualifier *GetTypeQualifier() const { return typeq; }
+    void FoldConstants();
+    bool IsGlobal();
 
 	llvm::Type* GetLlvmType() const {return type->typeToLlvmType(); };
 	llvm::Value* Emit();
@@ -88,9 +94,11 @@ class FnDecl : public Decl
     void SetFunctionBody(Stmt *b);
     const char *GetPrintNameForNode() { return "FnDecl"; }
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
 
     Type *GetType() const { return returnType; }
     List<VarDecl*> *GetFormals() {return formals;}
+    void FoldConstants();
 
 	llvm::Value* Emit();
 };
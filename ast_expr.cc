@@ -4,11 +4,180 @@
  */
 
 #include <string.h>
+#include <string>
+#include <algorithm>
 #include "ast_expr.h"
 #include "ast_type.h"
 #include "ast_decl.h"
 #include "symtable.h"
 
+Expr* Expr::Fold(Expr *expr)
+{
+	expr->FoldConstants();
+
+	llvm::Constant *value = expr->Evaluate();
+	if(value == NULL)
+		return expr;
+
+	return new FoldedConstant(expr, value);
+}
+
+llvm::Value* Expr::EmitRValue(Expr *expr)
+{
+	llvm::Value *value = expr->Emit();
+	if(value->getType()->isPointerTy())
+		value = irgen->CreateLoad(value);
+
+	return value;
+}
+
+llvm::Value* Expr::EmitUpdate(Expr *lvalue, const char *op, llvm::Value *operand, bool isUnsigned, bool postfix)
+{
+	//swizzles and components of vectors in registers are written
+	//through their base vector
+	FieldAccess *field = dynamic_cast<FieldAccess *>(lvalue);
+	ArrayAccess *element = dynamic_cast<ArrayAccess *>(lvalue);
+	llvm::SmallVector<int, 16> mask;
+	llvm::Value *index = NULL;
+	llvm::Value *address;
+	if(field != NULL)
+		address = field->EmitBase(mask);
+	else if(element != NULL)
+	{
+		address = element->EmitBase(index);
+		if(!irgen->IsSSAVariable(address))
+		{
+			address = element->EmitElement(address, index);
+			index = NULL;
+		}
+	}
+	else
+		address = lvalue->Emit();
+	Assert(address->getType()->isPointerTy());
+
+	//a swizzle or component needs the whole vector to write back into
+	llvm::Value *vector = NULL;
+	if(field != NULL || index != NULL || op != NULL)
+		vector = irgen->CreateLoad(address);
+
+	llvm::Value *current = NULL;
+	llvm::Value *result = operand;
+	if(op != NULL)
+	{
+		if(field != NULL)
+			current = irgen->CreateSwizzle(vector, mask);
+		else if(index != NULL)
+			current = irgen->GetBuilder()->CreateExtractElement(vector, index);
+		else
+			current = vector;
+
+		llvm::Type *type = current->getType();
+		if(operand == NULL && type->isFPOrFPVectorTy())
+			operand = llvm::ConstantFP::get(type, 1.0);
+		else if(operand == NULL)
+			operand = llvm::ConstantInt::get(type, 1);
+
+		result = irgen->CreateArithmetic(op, current, operand, isUnsigned);
+	}
+
+	if(field != NULL)
+		irgen->CreateStore(irgen->CreateSwizzleBlend(vector, result, mask), address);
+	else if(index != NULL)
+		irgen->CreateStore(irgen->GetBuilder()->CreateInsertElement(vector, result, index), address);
+	else
+		irgen->CreateStore(result, address);
+
+	return postfix ? current : result;
+}
+
+/* Class: CostEstimator
+ * --------------------
+ * Rough cost of evaluating an expression: one per operator, more for
+ * memory accesses and built-in calls.  Calls to user functions, anything
+ * that writes a variable and anything that may trap (a subscript not
+ * known to be in bounds, a division by a divisor that is not a constant
+ * other than 0 and -1) are side effects.
+ */
+class CostEstimator : public NodeVisitor
+{
+  public:
+    int cost;
+    bool sideEffects;
+    std::vector<Call *> calls;
+    std::vector<ArrayAccess *> accesses;
+
+    CostEstimator() : cost(0), sideEffects(false) {}
+    void Visit(Node *node);
+};
+
+void CostEstimator::Visit(Node *node)
+{
+	ArithmeticExpr *arith = dynamic_cast<ArithmeticExpr *>(node);
+	if(dynamic_cast<AssignExpr *>(node) != NULL || dynamic_cast<PostfixExpr *>(node) != NULL)
+		sideEffects = true;
+	else if(arith != NULL && (arith->GetOp()->IsOp("++") || arith->GetOp()->IsOp("--")))
+		sideEffects = true;
+	else if(arith != NULL && arith->GetLeft() != NULL && (arith->GetOp()->IsOp("/") || arith->GetOp()->IsOp("%")))
+	{
+		//float division does not trap, integer division by 0 or INT_MIN / -1 does
+		llvm::Constant *divisor = arith->GetRight()->Evaluate();
+		bool safe = divisor != NULL && (llvm::isa<llvm::ConstantFP>(divisor) ||
+			(llvm::isa<llvm::ConstantInt>(divisor) && !divisor->isNullValue() && !divisor->isAllOnesValue()));
+		if(!safe)
+			sideEffects = true;
+		cost += 1;
+	}
+	else if(Call *call = dynamic_cast<Call *>(node))
+		calls.push_back(call);
+	else if(ArrayAccess *access = dynamic_cast<ArrayAccess *>(node))
+	{
+		accesses.push_back(access);
+		cost += 2;
+	}
+	else if(dynamic_cast<CompoundExpr *>(node) != NULL || dynamic_cast<ConditionalExpr *>(node) != NULL)
+		cost += 1;
+}
+
+bool Expr::IsCheapToSpeculate(Expr *expr)
+{
+	CostEstimator estimator;
+	expr->Walk(&estimator);
+
+	//built-ins are a few instructions, user functions may do anything
+	llvm::Module *module = irgen->GetOrCreateModule("Module");
+	for(unsigned i = 0; i < estimator.calls.size(); i++)
+	{
+		if(module->getFunction(estimator.calls[i]->GetField()->GetName()) != NULL)
+			estimator.sideEffects = true;
+		else
+			estimator.cost += 4;
+	}
+
+	//a load out of bounds may fault
+	for(unsigned i = 0; i < estimator.accesses.size(); i++)
+	{
+		if(!estimator.accesses[i]->IsInBounds())
+			estimator.sideEffects = true;
+	}
+
+	return !estimator.sideEffects && estimator.cost <= GetIntOption("select-threshold", 6);
+}
+
+FoldedConstant::FoldedConstant(Expr *original, llvm::Constant *val) : Expr() {
+    Assert(original != NULL && val != NULL);
+    location = original->GetLocation();
+    parent = original->GetParent();
+    value = val;
+    isUnsigned = original->IsUnsigned();
+}
+
+void FoldedConstant::PrintChildren(int indentLevel) {
+    std::string str;
+    llvm::raw_string_ostream stream(str);
+    value->print(stream);
+    printf("%s", stream.str().c_str());
+}
+
 IntConstant::IntConstant(yyltype loc, int val) : Expr(loc) {
     value = val;
 }
@@ -48,12 +217,26 @@ llvm::Value* BoolConstant::Emit()
 VarExpr::VarExpr(yyltype loc, Identifier *ident) : Expr(loc) {
     Assert(ident != NULL);
     this->id = ident;
+    isUnsigned = false;
 }
 
 void VarExpr::PrintChildren(int indentLevel) {
     id->Print(indentLevel+1);
 }
 
+llvm::Type* VarExpr::GetValueType()
+{
+	Symbol *sym = symbolTable->find(id->GetName());
+	if(sym == NULL || sym->value == NULL)
+		return NULL;
+
+	llvm::Type *type = sym->value->getType();
+	if(type->isPointerTy())
+		type = type->getPointerElementType();
+
+	return type;
+}
+
 llvm::Value* VarExpr::Emit()
 {
 
@@ -81,6 +264,31 @@ llvm::Value* VarExpr::Emit()
 	
 }
 
+llvm::Constant* VarExpr::Evaluate()
+{
+	//const variables are entered with their value, all others with NULL
+	Symbol *sym = constTable->find(id->GetName());
+	if(sym == NULL || sym->value == NULL)
+		return NULL;
+
+	return llvm::cast<llvm::Constant>(sym->value);
+}
+
+void VarExpr::FoldConstants()
+{
+	//the declaration is only in scope while folding, remember its type
+	Symbol *sym = constTable->find(id->GetName());
+	VarDecl *decl = sym != NULL ? dynamic_cast<VarDecl *>(sym->decl) : NULL;
+	if(decl == NULL)
+		return;
+
+	ArrayType *arrayType = dynamic_cast<ArrayType *>(decl->GetType());
+	if(arrayType != NULL)
+		isUnsigned = arrayType->GetElemType()->IsUnsigned();
+	else
+		isUnsigned = decl->GetType()->IsUnsigned();
+}
+
 Operator::Operator(yyltype loc, const char *tok) : Node(loc) {
     Assert(tok != NULL);
     strncpy(tokenString, tok, sizeof(tokenString));
@@ -123,1796 +331,471 @@ void CompoundExpr::PrintChildren(int indentLevel) {
    if (right) right->Print(indentLevel+1);
 }
 
-llvm::Value* ArithmeticExpr::Emit()
-{
-	llvm::BasicBlock *bb = irgen->GetBasicBlock();
-
-	//TODO cheking the type of val does not work properly
+void CompoundExpr::WalkChildren(NodeVisitor *visitor) {
+   if (left) left->Walk(visitor);
+   if (right) right->Walk(visitor);
+}
 
-	//involves 2 expressions
+void CompoundExpr::FoldConstants()
+{
 	if(left != NULL)
-	{
-		//get llvm values
-		llvm::Value *varRight = right->Emit();
-		llvm::Value *valRight = varRight;
-		
-		llvm::Value *varLeft = left->Emit();
-		llvm::Value *valLeft = varLeft;
+		left = Fold(left);
+	if(right != NULL)
+		right = Fold(right);
+}
 
+bool CompoundExpr::IsUnsigned()
+{
+	return (left != NULL && left->IsUnsigned()) || (right != NULL && right->IsUnsigned());
+}
 
+void ArithmeticExpr::FoldConstants()
+{
+	//the operand of ++ and -- is written, only its subexpressions fold
+	if(op->IsOp("++") || op->IsOp("--"))
+		right->FoldConstants();
+	else
+		CompoundExpr::FoldConstants();
+}
 
-		//check if either side is a float
-		bool valRightFloat = symbolTable->GetType(varRight)->isFloatTy();
-		bool valLeftFloat = symbolTable->GetType(varRight)->isFloatTy();
+bool ArithmeticExpr::IsUnsigned()
+{
+	//a shift has the type of the value shifted, whatever the count is
+	if(op->IsOp("<<") || op->IsOp(">>"))
+		return left->IsUnsigned();
 
+	return CompoundExpr::IsUnsigned();
+}
 
-		//load value if necessary
-		if(llvm::AllocaInst::classof(valLeft) || llvm::GlobalVariable::classof(valLeft) || llvm::GetElementPtrInst::classof(valLeft))
-		{
-			valLeft = new llvm::LoadInst(valLeft, "", irgen->GetBasicBlock());
-		}
+llvm::Constant* ArithmeticExpr::Evaluate()
+{
+	if(op->IsOp("++") || op->IsOp("--"))
+		return NULL;
 
-		if(llvm::AllocaInst::classof(valRight) || llvm::GlobalVariable::classof(valRight) || llvm::GetElementPtrInst::classof(valRight))
-		{
-			valRight = new llvm::LoadInst(valRight, "", irgen->GetBasicBlock());
-		}
+	llvm::Constant *valRight = right->Evaluate();
+	if(valRight == NULL)
+		return NULL;
 
-		//type of values
-		llvm::Type *valType = valLeft->getType();
-		llvm::BinaryOperator *binInst;
+	//the builder folds constant operands, no instruction is created
+	if(left == NULL)
+	{
+		if(op->IsOp("+"))
+			return valRight;
+		if(op->IsOp("~"))
+			return llvm::cast<llvm::Constant>(irgen->GetBuilder()->CreateNot(valRight));
 
-		if(op->IsOp("*"))
-		{
+		llvm::Constant *zero = llvm::Constant::getNullValue(valRight->getType());
+		return llvm::cast<llvm::Constant>(irgen->CreateArithmetic("-", zero, valRight));
+	}
 
-			//integers
-			if(valType->isIntegerTy())
-			{	
-				binInst = llvm::BinaryOperator::CreateMul(valLeft, valRight, "");
-			}
-			//shuffle and float
-			else if(llvm::ShuffleVectorInst::classof(valRight) && valLeftFloat)
-			{
-				//get vector
-				llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valRight);
-				char *vecName = dynamic_cast<FieldAccess *>(right)->GetBase();
-				llvm::Value *var = symbolTable->find(vecName)->value;
+	llvm::Constant *valLeft = left->Evaluate();
+	if(valLeft == NULL)
+		return NULL;
 
-	
-				llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-				
-				llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-				llvm::InsertElementInst *insert = NULL;
-				llvm::SmallVector<int, 16>::iterator it = mask.begin();
-				int maskSize = 0;
-
-				//calculate mask size
-				for(it = mask.begin(); it != mask.end(); it++)
-					maskSize++;
-
-				int i = 0;
-				for(it = mask.begin(); it != mask.end(); it++, i++)
-				{
-
-					if(i == 0)
-					{
-						if(maskSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(maskSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFMul(insert, valRight, "");
-					
-			}
-			//float and shufflevector
-			else if(llvm::ShuffleVectorInst::classof(valLeft) && valRightFloat)
-			{
-
-				//get vector
-				llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valLeft);
-				char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-				llvm::Value *var = symbolTable->find(vecName)->value;
+	return llvm::cast<llvm::Constant>(irgen->CreateArithmetic(op->GetToken(), valLeft, valRight, IsUnsigned()));
+}
 
-	
-				llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-				
-				llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-				llvm::InsertElementInst *insert = NULL;
-				llvm::SmallVector<int, 16>::iterator it = mask.begin();
-				int maskSize = 0;
-
-				//calculate mask size
-				for(it = mask.begin(); it != mask.end(); it++)
-					maskSize++;
-
-				int i = 0;
-				for(it = mask.begin(); it != mask.end(); it++, i++)
-				{
-
-					if(i == 0)
-					{
-						if(maskSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(maskSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFMul(insert, valLeft, "");
-			}
-			//float and vector
-			else if(llvm::VectorType::classof(symbolTable->GetType(varRight)) && valLeftFloat)
-			{
-				//llvm::LoadInst *vector = new llvm::LoadInst(valRight, "", irgen->GetBasicBlock());
-				llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(symbolTable->GetType(varRight));
-				int vecSize = vecType->getNumElements();
-
-				llvm::InsertElementInst *insert = NULL;
-				for(int i = 0; i < vecSize; i++)
-				{
-
-					if(i == 0)
-					{
-						if(vecSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(vecSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFMul(insert, valRight, "");
-			}
-			//vector and float
-			else if(llvm::VectorType::classof(symbolTable->GetType(varLeft)) && valRightFloat)
-			{
-
-				//llvm::LoadInst *vector = new llvm::LoadInst(varLeft, "", irgen->GetBasicBlock());
-				llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(symbolTable->GetType(varLeft));
-				int vecSize = vecType->getNumElements();
-
-				llvm::InsertElementInst *insert = NULL;
-				for(int i = 0; i < vecSize; i++)
-				{
-
-					if(i == 0)
-					{
-						if(vecSize ==  2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(vecSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFMul(insert, valLeft, "");
-			}
-			//floats
-			else
-			{
-
-				binInst = llvm::BinaryOperator::CreateFMul(valLeft, valRight, "");
-			}
-		}
-		else if(op->IsOp("/"))
-		{
+llvm::Value* ArithmeticExpr::EmitContracted()
+{
+	ArithmeticExpr *leftMul = dynamic_cast<ArithmeticExpr *>(left);
+	ArithmeticExpr *rightMul = dynamic_cast<ArithmeticExpr *>(right);
+	if(leftMul != NULL && (leftMul->left == NULL || !leftMul->op->IsOp("*")))
+		leftMul = NULL;
+	if(rightMul != NULL && (rightMul->left == NULL || !rightMul->op->IsOp("*")))
+		rightMul = NULL;
+	if(leftMul == NULL && rightMul == NULL)
+		return NULL;
+
+	//operands in source order
+	ArithmeticExpr *mul = leftMul != NULL ? leftMul : rightMul;
+	llvm::Value *addend = leftMul == NULL ? EmitRValue(left) : NULL;
+	llvm::Value *a = EmitRValue(mul->left);
+	llvm::Value *b = EmitRValue(mul->right);
+	if(addend == NULL)
+		addend = EmitRValue(right);
+
+	//mixed shapes (vec * float) or ints, multiply and add separately
+	llvm::Type *type = a->getType();
+	if(!type->isFPOrFPVectorTy() || b->getType() != type || addend->getType() != type)
+	{
+		llvm::Value *product = irgen->CreateArithmetic("*", a, b);
+		if(leftMul != NULL)
+			return irgen->CreateArithmetic(op->GetToken(), product, addend);
+		return irgen->CreateArithmetic(op->GetToken(), addend, product);
+	}
 
-			//integers
-			if(valType->isIntegerTy())
-			{	
-				binInst = llvm::BinaryOperator::CreateSDiv(valLeft, valRight, "");
-			}
-			//shuffle and float
-			else if(llvm::ShuffleVectorInst::classof(valRight) && valLeftFloat)
-			{
-				//get vector
-				llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valRight);
-				char *vecName = dynamic_cast<FieldAccess *>(right)->GetBase();
-				llvm::Value *var = symbolTable->find(vecName)->value;
+	//a * b - c = fmuladd(a, b, -c) and c - a * b = fmuladd(-a, b, c)
+	if(op->IsOp("-") && leftMul != NULL)
+		addend = irgen->GetBuilder()->CreateFNeg(addend);
+	else if(op->IsOp("-"))
+		a = irgen->GetBuilder()->CreateFNeg(a);
 
-	
-				llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-				
-				llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-				llvm::InsertElementInst *insert = NULL;
-				llvm::SmallVector<int, 16>::iterator it = mask.begin();
-				int maskSize = 0;
-
-				//calculate mask size
-				for(it = mask.begin(); it != mask.end(); it++)
-					maskSize++;
-
-				int i = 0;
-				for(it = mask.begin(); it != mask.end(); it++, i++)
-				{
-
-					if(i == 0)
-					{
-						if(maskSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(maskSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFDiv(insert, vector, "");
-					
-			}
-			//float and shufflevector
-			else if(llvm::ShuffleVectorInst::classof(valLeft) && valRightFloat)
-			{
-
-				//get vector
-				llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valLeft);
-				char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-				llvm::Value *var = symbolTable->find(vecName)->value;
+	return irgen->CreateFMulAdd(a, b, addend);
+}
 
-	
-				llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-				
-				llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-				llvm::InsertElementInst *insert = NULL;
-				llvm::SmallVector<int, 16>::iterator it = mask.begin();
-				int maskSize = 0;
-
-				//calculate mask size
-				for(it = mask.begin(); it != mask.end(); it++)
-					maskSize++;
-
-				int i = 0;
-				for(it = mask.begin(); it != mask.end(); it++, i++)
-				{
-
-					if(i == 0)
-					{
-						if(maskSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(maskSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFDiv(vector, insert, "");
-			}
-			//float and vector
-			else if(llvm::VectorType::classof(symbolTable->GetType(varRight)) && valLeftFloat)
-			{
-				//llvm::LoadInst *vector = new llvm::LoadInst(valRight, "", irgen->GetBasicBlock());
-				llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(symbolTable->GetType(varRight));
-				int vecSize = vecType->getNumElements();
-
-				llvm::InsertElementInst *insert = NULL;
-				for(int i = 0; i < vecSize; i++)
-				{
-
-					if(i == 0)
-					{
-						if(vecSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(vecSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFDiv(insert, valRight, "");
-			}
-			//vector and float
-			else if(llvm::VectorType::classof(symbolTable->GetType(varLeft)) && valRightFloat)
-			{
-				//llvm::LoadInst *vector = new llvm::LoadInst(valLeft, "", irgen->GetBasicBlock());
-				llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(valLeft->getType());
-				int vecSize = vecType->getNumElements();
-
-				llvm::InsertElementInst *insert = NULL;
-				for(int i = 0; i < vecSize; i++)
-				{
-
-					if(i == 0)
-					{
-						if(vecSize ==  2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(vecSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFDiv(valLeft, insert, "");
-			}
-			//floats
-			else
-			{
-				binInst = llvm::BinaryOperator::CreateFDiv(valLeft, valRight, "");
-			}
+//operands of a chain of one binary operator, a * b * (c * d) -> a, b, c, d
+static void CollectOperands(Expr *expr, const char *op, std::vector<Expr *> &operands)
+{
+	ArithmeticExpr *arith = dynamic_cast<ArithmeticExpr *>(expr);
+	if(arith == NULL || arith->GetLeft() == NULL || !arith->GetOp()->IsOp(op))
+	{
+		operands.push_back(expr);
+		return;
+	}
 
-		}
-		else if(op->IsOp("+"))
-		{
+	CollectOperands(arith->GetLeft(), op, operands);
+	CollectOperands(arith->GetRight(), op, operands);
+}
 
-			//integers
-			if(valType->isIntegerTy())
-			{	
-				binInst = llvm::BinaryOperator::CreateAdd(valLeft, valRight, "");
-			}
-			//shuffle and float
-			else if(llvm::ShuffleVectorInst::classof(valRight) && valLeftFloat)
-			{
-				//get vector
-				llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valRight);
-				char *vecName = dynamic_cast<FieldAccess *>(right)->GetBase();
-				llvm::Value *var = symbolTable->find(vecName)->value;
+//one component of a vector variable, v.y
+static VarExpr *ComponentOf(Expr *expr, int &lane)
+{
+	FieldAccess *field = dynamic_cast<FieldAccess *>(expr);
+	if(field == NULL || field->GetMask().size() != 1)
+		return NULL;
 
-	
-				llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-				
-				llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-				llvm::InsertElementInst *insert = NULL;
-				llvm::SmallVector<int, 16>::iterator it = mask.begin();
-				int maskSize = 0;
-
-				//calculate mask size
-				for(it = mask.begin(); it != mask.end(); it++)
-					maskSize++;
-
-				int i = 0;
-				for(it = mask.begin(); it != mask.end(); it++, i++)
-				{
-
-					if(i == 0)
-					{
-						if(maskSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(maskSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFAdd(insert, vector, "");
-					
-			}
-			//float and shufflevector
-			else if(llvm::ShuffleVectorInst::classof(valLeft) && valRightFloat)
-			{
-
-				//get vector
-				llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valLeft);
-				char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-				llvm::Value *var = symbolTable->find(vecName)->value;
+	lane = field->GetMask()[0];
+	return dynamic_cast<VarExpr *>(field->GetBase());
+}
 
-	
-				llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-				
-				llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-				llvm::InsertElementInst *insert = NULL;
-				llvm::SmallVector<int, 16>::iterator it = mask.begin();
-				int maskSize = 0;
-
-				//calculate mask size
-				for(it = mask.begin(); it != mask.end(); it++)
-					maskSize++;
-
-				int i = 0;
-				for(it = mask.begin(); it != mask.end(); it++, i++)
-				{
-
-					if(i == 0)
-					{
-						if(maskSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(maskSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFAdd(vector, insert, "");
-			}
-			//float and vector
-			else if(llvm::VectorType::classof(symbolTable->GetType(varRight)) && valLeftFloat)
-			{
-				//llvm::LoadInst *vector = new llvm::LoadInst(valRight, "", irgen->GetBasicBlock());
-				llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(symbolTable->GetType(varRight));
-				int vecSize = vecType->getNumElements();
-
-				llvm::InsertElementInst *insert = NULL;
-				for(int i = 0; i < vecSize; i++)
-				{
-
-					if(i == 0)
-					{
-						if(vecSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(vecSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFAdd(insert, valRight, "");
-			}
-			//vector and float
-			else if(llvm::VectorType::classof(symbolTable->GetType(varLeft)) && valRightFloat)
-			{
-				llvm::LoadInst *vector = new llvm::LoadInst(valLeft, "", irgen->GetBasicBlock());
-				llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(symbolTable->GetType(varLeft));
-				int vecSize = vecType->getNumElements();
-
-				llvm::InsertElementInst *insert = NULL;
-				for(int i = 0; i < vecSize; i++)
-				{
-
-					if(i == 0)
-					{
-						if(vecSize ==  2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(vecSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFAdd(valLeft, insert, "");
-			}
-			//floats
-			else
-			{
-				binInst = llvm::BinaryOperator::CreateFAdd(valLeft, valRight, "");
-			}
-		}
-		else if(op->IsOp("-"))
+llvm::Value* ArithmeticExpr::EmitReduction()
+{
+	std::vector<Expr *> terms;
+	CollectOperands(this, "+", terms);
+	if(terms.size() < 2)
+		return NULL;
+
+	//every term a.i * b.i with the same a and b, or every term a.i
+	VarExpr *vars[2] = { NULL, NULL };
+	std::vector<int> lanes[2];
+	int count = 0;
+	for(unsigned i = 0; i < terms.size(); i++)
+	{
+		Expr *operands[2] = { terms[i], NULL };
+		ArithmeticExpr *mul = dynamic_cast<ArithmeticExpr *>(terms[i]);
+		if(mul != NULL && mul->left != NULL && mul->op->IsOp("*"))
 		{
-
-			//integers
-			if(valType->isIntegerTy())
-			{	
-				binInst = llvm::BinaryOperator::CreateSub(valLeft, valRight, "");
-
-			}
-			//shuffle and float
-			else if(llvm::ShuffleVectorInst::classof(valRight) && valLeftFloat)
-			{
-				//get vector
-				llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valRight);
-				char *vecName = dynamic_cast<FieldAccess *>(right)->GetBase();
-				llvm::Value *var = symbolTable->find(vecName)->value;
-
-	
-				llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-				
-				llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-				llvm::InsertElementInst *insert = NULL;
-				llvm::SmallVector<int, 16>::iterator it = mask.begin();
-				int maskSize = 0;
-
-				//calculate mask size
-				for(it = mask.begin(); it != mask.end(); it++)
-					maskSize++;
-
-				int i = 0;
-				for(it = mask.begin(); it != mask.end(); it++, i++)
-				{
-
-					if(i == 0)
-					{
-						if(maskSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(maskSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFSub(insert, vector, "");
-					
-			}
-			//float and shufflevector
-			else if(llvm::ShuffleVectorInst::classof(valLeft) && valRightFloat)
-			{
-
-				//get vector
-				llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valLeft);
-				char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-				llvm::Value *var = symbolTable->find(vecName)->value;
-
-	
-				llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-				
-				llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-				llvm::InsertElementInst *insert = NULL;
-				llvm::SmallVector<int, 16>::iterator it = mask.begin();
-				int maskSize = 0;
-
-				//calculate mask size
-				for(it = mask.begin(); it != mask.end(); it++)
-					maskSize++;
-
-				int i = 0;
-				for(it = mask.begin(); it != mask.end(); it++, i++)
-				{
-
-					if(i == 0)
-					{
-						if(maskSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(maskSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFSub(vector, insert, "");
-			}
-			//float and vector
-			else if(llvm::VectorType::classof(symbolTable->GetType(varRight)) && valLeftFloat)
-			{
-				//llvm::LoadInst *vector = new llvm::LoadInst(valRight, "", irgen->GetBasicBlock());
-				llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(symbolTable->GetType(varRight));
-				int vecSize = vecType->getNumElements();
-
-				llvm::InsertElementInst *insert = NULL;
-				for(int i = 0; i < vecSize; i++)
-				{
-
-					if(i == 0)
-					{
-						if(vecSize == 2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(vecSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valLeft, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFSub(insert, valRight, "");
-			}
-			//vector and float
-			else if(llvm::VectorType::classof(symbolTable->GetType(varLeft)) && valRightFloat)
-			{
-				//llvm::LoadInst *vector = new llvm::LoadInst(valLeft, "", irgen->GetBasicBlock());
-				llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(symbolTable->GetType(varLeft));
-				int vecSize = vecType->getNumElements();
-
-				llvm::InsertElementInst *insert = NULL;
-				for(int i = 0; i < vecSize; i++)
-				{
-
-					if(i == 0)
-					{
-						if(vecSize ==  2)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else if(vecSize == 3)
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-						else
-							insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-					else
-						insert = llvm::InsertElementInst::Create(insert, valRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-				}
-				
-				binInst = llvm::BinaryOperator::CreateFSub(valLeft, insert, "");
-			}
-			//float and vector
-			else
-			{
-				binInst = llvm::BinaryOperator::CreateFSub(valLeft, valRight, "");
-			}
+			operands[0] = mul->left;
+			operands[1] = mul->right;
 		}
 
-		//add inst to current basic block
-		bb->getInstList().push_back(binInst);
-		return binInst;
-
-	}
-	//unary expresssion
-	else
-	{
-		
-		//get llvm value of expr
-		llvm::Value *varStore = right->Emit();
-		llvm::Value *valueRight = varStore;
+		int termCount = operands[1] != NULL ? 2 : 1;
+		if(i == 0)
+			count = termCount;
+		if(termCount != count)
+			return NULL;
 
-		//load value if necessary
-		if(llvm::AllocaInst::classof(valueRight) || llvm::GlobalVariable::classof(valueRight) || llvm::GetElementPtrInst::classof(valueRight))
+		VarExpr *termVars[2];
+		int termLanes[2];
+		for(int k = 0; k < count; k++)
 		{
-			valueRight = new llvm::LoadInst(valueRight, "", irgen->GetBasicBlock());
+			termVars[k] = ComponentOf(operands[k], termLanes[k]);
+			if(termVars[k] == NULL)
+				return NULL;
 		}
-
-		llvm::Type *valType = valueRight->getType();
-		llvm::Constant *valLeft;
-		llvm::BinaryOperator *binInst;
-		
-		if(op->IsOp("++"))
+		if(i == 0)
 		{
-			//integer
-			if(valType->isIntegerTy())
-			{	
-				valLeft = llvm::ConstantInt::get(irgen->GetIntType(), 1, true);
-				binInst = llvm::BinaryOperator::CreateAdd(valLeft, valueRight, "");
-
-			}
-			//float and vector
-			else
-			{
-				valLeft = llvm::ConstantFP::get(irgen->GetFloatType(), 1.0);
-				binInst = llvm::BinaryOperator::CreateFAdd(valLeft, valueRight, "");
-			}
-
+			vars[0] = termVars[0];
+			vars[1] = termVars[1];
 		}
-		else if(op->IsOp("--"))
-		{
 
-			//integers
-			if(valType->isIntegerTy())
-			{	
-				valLeft = llvm::ConstantInt::get(valType, 1, true);
-				binInst = llvm::BinaryOperator::CreateSub(valueRight, valLeft, "");
-		
-			}
-			//float and vector
-			else
-			{
-				valLeft = llvm::ConstantFP::get(valType, 1.0);
-				binInst = llvm::BinaryOperator::CreateFSub(valueRight, valLeft, "");
-			}
-		}
-		else if(op->IsOp("-"))
+		//b.i * a.i is the same term
+		if(count == 2 && strcmp(termVars[0]->GetIdentifier()->GetName(), vars[0]->GetIdentifier()->GetName()) != 0)
 		{
-			//integers
-			if(valType->isIntegerTy())
-			{	
-				valLeft = llvm::ConstantInt::get(valType, 0, true);
-				binInst = llvm::BinaryOperator::CreateSub(valLeft, valueRight, "");
-				bb->getInstList().push_back(binInst);
-				return binInst;
-				
-			}
-			//float and vector
-			else
-			{
-				valLeft = llvm::ConstantFP::get(valType, 0.0);
-				binInst = llvm::BinaryOperator::CreateFSub(valLeft, valueRight, "");
-				bb->getInstList().push_back(binInst);
-				return binInst;
-			}
+			std::swap(termVars[0], termVars[1]);
+			std::swap(termLanes[0], termLanes[1]);
 		}
-		// "+"
-		else
+
+		for(int k = 0; k < count; k++)
 		{
-			//simply return the llvm value, since "+(variable)" == "variable"
-			return right->Emit();
+			if(strcmp(termVars[k]->GetIdentifier()->GetName(), vars[k]->GetIdentifier()->GetName()) != 0)
+				return NULL;
+			lanes[k].push_back(termLanes[k]);
 		}
-		
-		//store result and add instructions to current basic block
-		bb->getInstList().push_back(binInst);
-		new llvm::StoreInst(binInst, varStore, true, irgen->GetBasicBlock());
-
-		return binInst;
-
-	}//end of unary else
-}
-
-llvm::Value* RelationalExpr::Emit()
-{
-	//TODO checking of type not working!!!!
-
-	llvm::Value *val1 = left->Emit();
-	llvm::Value *val2 = right->Emit();
-	llvm::Type *type = symbolTable->GetType(val1);
-	llvm::CmpInst *cmp;
-	llvm::BasicBlock *bb = irgen->GetBasicBlock();
-
-	//load variable if necessary
-	if(llvm::AllocaInst::classof(val1) || llvm::GlobalVariable::classof(val1) || llvm::GetElementPtrInst::classof(val1))
-	{
-		val1 = new llvm::LoadInst(val1, "", irgen->GetBasicBlock());
 	}
 
-	if(llvm::AllocaInst::classof(val2) || llvm::GlobalVariable::classof(val2) || llvm::GetElementPtrInst::classof(val2))
+	//only float vectors, checked before any code is emitted
+	for(int k = 0; k < count; k++)
 	{
-		val2 = new llvm::LoadInst(val2, "", irgen->GetBasicBlock());
+		llvm::VectorType *vecType = llvm::dyn_cast_or_null<llvm::VectorType>(vars[k]->GetValueType());
+		if(vecType == NULL || !vecType->getElementType()->isFloatingPointTy())
+			return NULL;
 	}
 
-	//generate compare instruction
-	if(op->IsOp("<"))
-	{
-		if(type->isFloatTy())
-			cmp = new llvm::FCmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::FCMP_OLT, val1, val2, "");
-		else
-			cmp = new llvm::ICmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::ICMP_ULT, val1, val2, "");
-	}
-	else if(op->IsOp(">"))
-	{
-		
-		if(type->isFloatTy())
-			cmp = new llvm::FCmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::FCMP_OGT, val1, val2, "");
-		else
-			cmp = new llvm::ICmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::ICMP_UGT, val1, val2, "");
-		
-	}
-	else if(op->IsOp("<="))
+	//the lanes used, side by side in one vector each
+	llvm::Value *vectors[2] = { NULL, NULL };
+	for(int k = 0; k < count; k++)
 	{
-		if(type->isFloatTy())
-			cmp = new llvm::FCmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::FCMP_OLE, val1, val2, "");
-		else
-			cmp = new llvm::ICmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::ICMP_ULE, val1, val2, "");	
+		vectors[k] = EmitRValue(vars[k]);
+		unsigned width = llvm::cast<llvm::VectorType>(vectors[k]->getType())->getNumElements();
+
+		bool whole = lanes[k].size() == width;
+		for(unsigned lane = 0; lane < lanes[k].size() && whole; lane++)
+			whole = lanes[k][lane] == (int)lane;
+		if(!whole)
+			vectors[k] = irgen->CreateSwizzle(vectors[k], lanes[k]);
 	}
-	else if(op->IsOp(">="))
+
+	int line = GetLocation() ? GetLocation()->first_line : 0;
+	if(count == 2)
+		PrintStat("dot product of %s and %s at line %d", vars[0]->GetIdentifier()->GetName(), vars[1]->GetIdentifier()->GetName(), line);
+	else
 	{
-		if(type->isFloatTy())
-			cmp = new llvm::FCmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::FCMP_OGE, val1, val2, "");
-		else
-			cmp = new llvm::ICmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::ICMP_UGE, val1, val2, "");
+		PrintStat("sum of the components of %s at line %d", vars[0]->GetIdentifier()->GetName(), line);
+		vectors[1] = llvm::ConstantFP::get(vectors[0]->getType(), 1.0);
 	}
 
-	//add inst to current basic block
-	//bb->getInstList().push_back(cmp);
-	return cmp;
+	//one vector multiply and a reduction
+	return irgen->CreateDot(vectors[0], vectors[1]);
 }
 
-llvm::Value* EqualityExpr::Emit()
+llvm::Value* ArithmeticExpr::EmitAsWritten(const std::vector<llvm::Value *> &values, unsigned &next)
 {
-	//TODO checking of type not working
-
-	llvm::Value *val1 = left->Emit();
-	llvm::Value *val2 = right->Emit();
-	llvm::Type *type = symbolTable->GetType(val1);
-
-	//load variable if necessary
-	if(llvm::AllocaInst::classof(val1) || llvm::GlobalVariable::classof(val1) || llvm::GetElementPtrInst::classof(val1))
+	llvm::Value *product = NULL;
+	Expr *operands[] = { left, right };
+	for(int i = 0; i < 2; i++)
 	{
-		val1 = new llvm::LoadInst(val1, "", irgen->GetBasicBlock());
-	}
-
-	if(llvm::AllocaInst::classof(val2) || llvm::GlobalVariable::classof(val2) || llvm::GetElementPtrInst::classof(val2))
-	{
-		val2 = new llvm::LoadInst(val2, "", irgen->GetBasicBlock());
-	}
-
-	//generate compare inst
-	llvm::CmpInst *cmp;
-	if(op->IsOp("=="))
-	{
-		if(type->isFloatTy())
-		{
-			cmp = new llvm::FCmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::FCMP_OEQ, val1, val2, "");
-		}
+		ArithmeticExpr *mul = dynamic_cast<ArithmeticExpr *>(operands[i]);
+		llvm::Value *value;
+		if(mul != NULL && mul->left != NULL && mul->op->IsOp("*"))
+			value = mul->EmitAsWritten(values, next);
 		else
-			cmp = new llvm::ICmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::ICMP_EQ, val1, val2, "");
-	}
-	else if(op->IsOp("!="))
-	{
-		if(type->isFloatTy())
-			cmp = new llvm::FCmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::FCMP_ONE, val1, val2, "");
-		else
-			cmp = new llvm::ICmpInst(*(irgen->GetBasicBlock()), llvm::CmpInst::ICMP_NE, val1, val2, "");
+			value = values[next++];
+
+		product = product == NULL ? value : irgen->CreateArithmetic("*", product, value, IsUnsigned());
 	}
-	
-	return cmp;
+	return product;
 }
 
-llvm::Value* LogicalExpr::Emit()
+llvm::Value* ArithmeticExpr::EmitScalarsFirst()
 {
-	llvm::Value *val2 = right->Emit();
-	llvm::Value *val1 = left->Emit();
-
-	llvm::Type *type = val1->getType();
-
-	//load variable if necessary
-	if(llvm::AllocaInst::classof(val1) || llvm::GlobalVariable::classof(val1) || llvm::GetElementPtrInst::classof(val1))
+	std::vector<Expr *> factors;
+	CollectOperands(this, "*", factors);
+	if(factors.size() < 3)
+		return NULL;
+
+	//operands in source order, as they would be without reassociation
+	std::vector<llvm::Value *> values;
+	bool hasMatrix = false;
+	for(unsigned i = 0; i < factors.size(); i++)
 	{
-		val1 = new llvm::LoadInst(val1, "", irgen->GetBasicBlock());
+		values.push_back(EmitRValue(factors[i]));
+		hasMatrix = hasMatrix || values.back()->getType()->isArrayTy();
 	}
 
-	if(llvm::AllocaInst::classof(val2) || llvm::GlobalVariable::classof(val2) || llvm::GetElementPtrInst::classof(val2))
+	//matrix products do not commute, multiply them as written
+	if(hasMatrix)
 	{
-		val2 = new llvm::LoadInst(val2, "", irgen->GetBasicBlock());
+		unsigned next = 0;
+		return EmitAsWritten(values, next);
 	}
 
-	//generator inst
-	if(op->IsOp("&&"))
+	//scalars multiplied together first, then one splat for all of them
+	llvm::Value *scalar = NULL;
+	llvm::Value *vector = NULL;
+	for(unsigned i = 0; i < values.size(); i++)
 	{
-
-		llvm::BinaryOperator *binAnd = llvm::BinaryOperator::CreateAnd(val1, val2, "");
-		irgen->GetBasicBlock()->getInstList().push_back(binAnd);
-		return binAnd;
+		llvm::Value *&product = values[i]->getType()->isVectorTy() ? vector : scalar;
+		product = product == NULL ? values[i] : irgen->CreateArithmetic("*", product, values[i], IsUnsigned());
 	}
-	else if(op->IsOp("||"))
-	{
-		llvm::BinaryOperator *binOr = llvm::BinaryOperator::CreateOr(val1, val2, "");
-		irgen->GetBasicBlock()->getInstList().push_back(binOr);
-		return binOr;
-	}
-}
 
-llvm::Value* AssignExpr::Emit()
-{	
+	if(vector == NULL)
+		return scalar;
+	if(scalar == NULL)
+		return vector;
 
-	//current basic block
-	llvm::BasicBlock *bb = irgen->GetBasicBlock();
-
-	//get llvm value of expressions
-	llvm::Value *varRight = right->Emit();
-	llvm::Value *valueRight = varRight;
-	llvm::Value *varLeft = left->Emit();
-	llvm::Value *valueLeft = varLeft;
-	llvm::StoreInst *storeInst;
+	return irgen->CreateArithmetic("*", vector, scalar, IsUnsigned());
+}
 
-	//load right value if necessary
-	if(llvm::AllocaInst::classof(valueRight) || llvm::GlobalVariable::classof(valueRight) || llvm::GetElementPtrInst::classof(valueRight))
+llvm::Value* ArithmeticExpr::Emit()
+{
+	//v * s1 * s2 -> v * (s1 * s2), changes rounding so only with -freassoc
+	//or -ffast-math
+	if(left != NULL && op->IsOp("*") && irgen->AllowReassociation())
 	{
-		valueRight = new llvm::LoadInst(valueRight, "", irgen->GetBasicBlock());
+		llvm::Value *product = EmitScalarsFirst();
+		if(product != NULL)
+			return product;
 	}
 
-	//simple assigment
-	if(op->IsOp("="))
+	//a.x * b.x + a.y * b.y + ... -> dot(a.xy, b.xy), also only with -freassoc
+	if(left != NULL && op->IsOp("+") && irgen->AllowReassociation())
 	{
-
-		//setting one vector component
-		if(llvm::ExtractElementInst::classof(varLeft))
-		{
-
-			//get vector
-			llvm::ExtractElementInst *elmt = llvm::dyn_cast<llvm::ExtractElementInst>(varLeft);
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-			
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-
-			//insert new elemtn
-			llvm::InsertElementInst *insert = llvm::InsertElementInst::Create(vector, valueRight, elmt->getIndexOperand(), "insert", 
-																				irgen->GetBasicBlock());
-			//store insertion
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());	
-			
-			return valueRight;
-		}
-		//setting vector components
-		else if(llvm::ShuffleVectorInst::classof(varLeft))
-		{
-			//get vector
-			llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(varLeft);
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-
-			llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-			llvm::InsertElementInst *insert = NULL;
-			int i = 0;
-			for(llvm::SmallVector<int, 16>::iterator it = mask.begin(); it != mask.end(); it++, i++)
-			{
-				llvm::ExtractElementInst *ext = llvm::ExtractElementInst::Create(valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-				if(i == 0)
-					insert = llvm::InsertElementInst::Create(vector, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-				else
-					insert = llvm::InsertElementInst::Create(insert, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-					
-			}
-				
-			//store vector
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-	
-			return valueRight;
-		
-
-		}
-		else
-		{
-
-			storeInst = new llvm::StoreInst(valueRight, varLeft, true, irgen->GetBasicBlock());
-			return valueRight;
-		}
+		llvm::Value *sum = EmitReduction();
+		if(sum != NULL)
+			return sum;
 	}
 
-
-	//check if either side is of float type
-	bool valRightFloat = irgen->IsFloatType(valueRight);
-	bool valLeftFloat = irgen->IsFloatType(valueLeft);
-
-
-
-	//load left value
-	if(llvm::AllocaInst::classof(valueLeft) || llvm::GlobalVariable::classof(valueLeft) || llvm::GetElementPtrInst::classof(valueLeft))
+	//a * b + c in one expression, fused if contraction is allowed
+	if(left != NULL && irgen->AllowContraction() && (op->IsOp("+") || op->IsOp("-")))
 	{
-		valueLeft = new llvm::LoadInst(valueLeft, "", irgen->GetBasicBlock());
+		llvm::Value *fused = EmitContracted();
+		if(fused != NULL)
+			return fused;
 	}
 
-
-	//generate binary operation and store inst
-	llvm::Type *valType = symbolTable->GetType(varLeft);
-	llvm::BinaryOperator *binInst;
-
-
-
-	if(op->IsOp("*="))
+	//involves 2 expressions
+	if(left != NULL)
 	{
+		llvm::Value *valLeft = left->Emit();
+		if(valLeft->getType()->isPointerTy())
+			valLeft = irgen->CreateLoad(valLeft);
 
-		//integers
-		if(valType->isIntegerTy())
-		{	
-			binInst = llvm::BinaryOperator::CreateMul(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);			
+		llvm::Value *valRight = right->Emit();
+		if(valRight->getType()->isPointerTy())
+			valRight = irgen->CreateLoad(valRight);
 
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;		
-		}
-		//shuffle * float
-		else if(llvm::ShuffleVectorInst::classof(varLeft) && valRightFloat)
-		{
-			//get vector
-			llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(varLeft);
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-
-	
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-			
-			llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-			llvm::InsertElementInst *insert = NULL;
-			llvm::SmallVector<int, 16>::iterator it = mask.begin();
-			int maskSize = 0;
-
-			//calculate mask size
-			for(it = mask.begin(); it != mask.end(); it++)
-				maskSize++;
-
-			int i = 0;
-			for(it = mask.begin(); it != mask.end(); it++, i++)
-			{
-
-				if(i == 0)
-				{
-					if(maskSize == 2)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else if(maskSize == 3)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-				else
-					insert = llvm::InsertElementInst::Create(insert, valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-			}//end for
-				
-
-			//calculate muliplication
-			binInst = llvm::BinaryOperator::CreateFMul(insert, valueLeft, "");
-			bb->getInstList().push_back(binInst);			
-
-			//add result to vector
-			i = 0;
-			for(it = mask.begin(); it != mask.end(); it++, i++)
-			{
-				llvm::ExtractElementInst *ext = llvm::ExtractElementInst::Create(binInst, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-				if(i == 0)
-					insert = llvm::InsertElementInst::Create(vector, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-				else
-					insert = llvm::InsertElementInst::Create(insert, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-					
-			}
-
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
-
-		}
-		// shuffle * (shuffle or vector)
-		else if(llvm::ShuffleVectorInst::classof(varLeft) && (llvm::ShuffleVectorInst::classof(varRight) || llvm::VectorType::classof(symbolTable->GetType(varRight)) ))
-		{
-			//get shuffle and vector variable
-			llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valueLeft);
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-
-			//load vector
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-
-			//calcualte mult
-			binInst = llvm::BinaryOperator::CreateFMul(valueRight, valueLeft, "");
-			bb->getInstList().push_back(binInst);
-
-			//get valueLeft's mask from shuffle
-			llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			llvm::InsertElementInst *insert = NULL;
-				
-
-			//insert into vector
-			int i = 0;
-			for(llvm::SmallVector<int, 16>::iterator it = mask.begin(); it != mask.end(); it++, i++)
-			{
-				llvm::ExtractElementInst *ext = llvm::ExtractElementInst::Create(binInst, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-				if(i == 0)
-					insert = llvm::InsertElementInst::Create(vector, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-				else
-					insert = llvm::InsertElementInst::Create(insert, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-			}
-
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
-				
-		}
-		//vector * float
-		else if(llvm::VectorType::classof(symbolTable->GetType(varLeft)) && valRightFloat)
-		{
-
-			llvm::LoadInst *vector = new llvm::LoadInst(varLeft, "", irgen->GetBasicBlock());
-			llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(symbolTable->GetType(varLeft));
-			int vecSize = vecType->getNumElements();
-
-
-
-			//build new vector with right float value
-			llvm::InsertElementInst *insert = NULL;
-			int i;
-			for(i = 0; i < vecSize; i++)
-			{
-
-				if(i == 0)
-				{
-					if(vecSize == 2)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else if(vecSize == 3)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-				}
-				else
-					insert = llvm::InsertElementInst::Create(insert, valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-			}
-	
-			//calculate mult				
-			binInst = llvm::BinaryOperator::CreateFMul(insert, vector, "");
-			bb->getInstList().push_back(binInst);			
-
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;
-			
-		}
-		//vector component
-		else if(llvm::ExtractElementInst::classof(varLeft))
-		{
-			llvm::ExtractElementInst *ext = llvm::dyn_cast<llvm::ExtractElementInst>(varLeft);
-
-			//calculate div
-			binInst = llvm::BinaryOperator::CreateFMul(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);
-
-			//load vector
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-
-			//isert value into vector
-
-			llvm::InsertElementInst *insert = llvm::InsertElementInst::Create(vector, binInst, ext->getIndexOperand(), "", irgen->GetBasicBlock());
-
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
-		}
-		//floats
-		else
-		{
-			binInst = llvm::BinaryOperator::CreateFMul(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);
-
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;
-		}
-	
+		return irgen->CreateArithmetic(op->GetToken(), valLeft, valRight, IsUnsigned());
 	}
-	else if(op->IsOp("/="))
-	{
-
-		//integers
-		if(valType->isIntegerTy())
-		{	
-			binInst = llvm::BinaryOperator::CreateSDiv(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);			
-
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;
-		}
-		//shuffle * float
-		else if(llvm::ShuffleVectorInst::classof(varLeft) && valRightFloat)
-		{
-			//get vector
-			llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(varLeft);
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-
-	
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-			
-			llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-			llvm::InsertElementInst *insert = NULL;
-			llvm::SmallVector<int, 16>::iterator it = mask.begin();
-			int maskSize = 0;
-
-			//calculate mask size
-			for(it = mask.begin(); it != mask.end(); it++)
-				maskSize++;
-
-			int i = 0;
-			for(it = mask.begin(); it != mask.end(); it++, i++)
-			{
-
-				if(i == 0)
-				{
-					if(maskSize == 2)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else if(maskSize == 3)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-				else
-					insert = llvm::InsertElementInst::Create(insert, valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-			}//end for
-				
-
-			//calculate muliplication
-			binInst = llvm::BinaryOperator::CreateFDiv(valueLeft, insert, "");
-			bb->getInstList().push_back(binInst);			
-
-			//add result to vector
-			i = 0;
-			for(it = mask.begin(); it != mask.end(); it++, i++)
-			{
-				llvm::ExtractElementInst *ext = llvm::ExtractElementInst::Create(binInst, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-				if(i == 0)
-					insert = llvm::InsertElementInst::Create(vector, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-				else
-					insert = llvm::InsertElementInst::Create(insert, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-					
-			}
-
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
 
-		}
-		// shuffle * (shuffle or vector)
-		else if(llvm::ShuffleVectorInst::classof(varLeft) && (llvm::ShuffleVectorInst::classof(varRight) || llvm::VectorType::classof(symbolTable->GetType(varRight)) ))
-		{
-			//get shuffle and vector variable
-			llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valueLeft);
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-
-			//load vector
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-
-			//calcualte mult
-			binInst = llvm::BinaryOperator::CreateFDiv(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);
-
-			//get valueLeft's mask from shuffle
-			llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			llvm::InsertElementInst *insert = NULL;
-				
-
-			//insert into vector
-			int i = 0;
-			for(llvm::SmallVector<int, 16>::iterator it = mask.begin(); it != mask.end(); it++, i++)
-			{
-				llvm::ExtractElementInst *ext = llvm::ExtractElementInst::Create(binInst, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-				if(i == 0)
-					insert = llvm::InsertElementInst::Create(vector, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-				else
-					insert = llvm::InsertElementInst::Create(insert, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-			}
-
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
-				
-		}
-		//vector * float
-		else if(llvm::VectorType::classof(symbolTable->GetType(varLeft)) && valRightFloat)
-		{
+	// "+(variable)" == "variable"
+	if(op->IsOp("+"))
+		return right->Emit();
 
-			llvm::LoadInst *vector = new llvm::LoadInst(varLeft, "", irgen->GetBasicBlock());
-			llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(symbolTable->GetType(varLeft));
-			int vecSize = vecType->getNumElements();
+	//++ and --, store result back
+	if(op->IsOp("++") || op->IsOp("--"))
+		return EmitUpdate(right, op->IsOp("++") ? "+" : "-", NULL, IsUnsigned());
 
+	llvm::Value *valueRight = EmitRValue(right);
 
+	//negation
+	if(op->IsOp("-"))
+		return irgen->CreateArithmetic("-", llvm::Constant::getNullValue(valueRight->getType()), valueRight);
 
-			//build new vector with right float value
-			llvm::InsertElementInst *insert = NULL;
-			int i;
-			for(i = 0; i < vecSize; i++)
-			{
-
-				if(i == 0)
-				{
-					if(vecSize == 2)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else if(vecSize == 3)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-				}
-				else
-					insert = llvm::InsertElementInst::Create(insert, valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-			}
-	
-			//calculate mult				
-			binInst = llvm::BinaryOperator::CreateFDiv(vector, insert, "");
-			bb->getInstList().push_back(binInst);			
-	
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;
-			
-		}
-		//vector component
-		else if(llvm::ExtractElementInst::classof(varLeft))
-		{
-			llvm::ExtractElementInst *ext = llvm::dyn_cast<llvm::ExtractElementInst>(varLeft);
-
-			//calculate div
-			binInst = llvm::BinaryOperator::CreateFDiv(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);
-
-			//load vector
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-
-			//isert value into vector
-
-			llvm::InsertElementInst *insert = llvm::InsertElementInst::Create(vector, binInst, ext->getIndexOperand(), "", irgen->GetBasicBlock());
-
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
-		}
-		//floats
-		else
-		{
-			binInst = llvm::BinaryOperator::CreateFDiv(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);
-
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;		
-		}
-	}
-	else if(op->IsOp("-="))
-	{
-		//integers
-		if(valType->isIntegerTy())
-		{	
-			binInst = llvm::BinaryOperator::CreateSub(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);			
-
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;		
-		}
-		//shuffle * float
-		else if(llvm::ShuffleVectorInst::classof(varLeft) && valRightFloat)
-		{
-			//get vector
-			llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(varLeft);
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
+	//bitwise complement, xor with all ones
+	return irgen->GetBuilder()->CreateNot(valueRight);
+}
 
-	
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-			
-			llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-			llvm::InsertElementInst *insert = NULL;
-			llvm::SmallVector<int, 16>::iterator it = mask.begin();
-			int maskSize = 0;
-
-			//calculate mask size
-			for(it = mask.begin(); it != mask.end(); it++)
-				maskSize++;
-
-			int i = 0;
-			for(it = mask.begin(); it != mask.end(); it++, i++)
-			{
-
-				if(i == 0)
-				{
-					if(maskSize == 2)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else if(maskSize == 3)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-				else
-					insert = llvm::InsertElementInst::Create(insert, valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-			}//end for
-				
-
-			//calculate muliplication
-			binInst = llvm::BinaryOperator::CreateFSub(valueLeft, insert, "");
-			bb->getInstList().push_back(binInst);			
-
-			//add result to vector
-			i = 0;
-			for(it = mask.begin(); it != mask.end(); it++, i++)
-			{
-				llvm::ExtractElementInst *ext = llvm::ExtractElementInst::Create(binInst, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-				if(i == 0)
-					insert = llvm::InsertElementInst::Create(vector, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-				else
-					insert = llvm::InsertElementInst::Create(insert, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-					
-			}
-
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
+llvm::Constant* RelationalExpr::Evaluate()
+{
+	llvm::Constant *val1 = left->Evaluate();
+	llvm::Constant *val2 = right->Evaluate();
+	if(val1 == NULL || val2 == NULL)
+		return NULL;
 
-		}
-		// shuffle * (shuffle or vector)
-		else if(llvm::ShuffleVectorInst::classof(varLeft) && (llvm::ShuffleVectorInst::classof(varRight) || llvm::VectorType::classof(symbolTable->GetType(varRight)) ))
-		{
-			//get shuffle and vector variable
-			llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valueLeft);
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-
-			//load vector
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-
-			//calcualte mult
-			binInst = llvm::BinaryOperator::CreateFSub(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);
-
-			//get valueLeft's mask from shuffle
-			llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			llvm::InsertElementInst *insert = NULL;
-				
-
-			//insert into vector
-			int i = 0;
-			for(llvm::SmallVector<int, 16>::iterator it = mask.begin(); it != mask.end(); it++, i++)
-			{
-				llvm::ExtractElementInst *ext = llvm::ExtractElementInst::Create(binInst, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-				if(i == 0)
-					insert = llvm::InsertElementInst::Create(vector, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-				else
-					insert = llvm::InsertElementInst::Create(insert, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-			}
-
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
-				
-		}
-		//vector * float
-		else if(llvm::VectorType::classof(symbolTable->GetType(varLeft)) && valRightFloat)
-		{
+	return llvm::cast<llvm::Constant>(irgen->CreateComparison(op->GetToken(), val1, val2, CompoundExpr::IsUnsigned()));
+}
 
-			llvm::LoadInst *vector = new llvm::LoadInst(varLeft, "", irgen->GetBasicBlock());
-			llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(symbolTable->GetType(varLeft));
-			int vecSize = vecType->getNumElements();
+llvm::Value* RelationalExpr::Emit()
+{
+	llvm::Value *val1 = EmitRValue(left);
+	llvm::Value *val2 = EmitRValue(right);
 
+	//ints compare signed unless an operand is a uint, vectors compare
+	//component-wise into a bvec
+	return irgen->CreateComparison(op->GetToken(), val1, val2, CompoundExpr::IsUnsigned());
+}
 
+llvm::Constant* EqualityExpr::Evaluate()
+{
+	llvm::Constant *val1 = left->Evaluate();
+	llvm::Constant *val2 = right->Evaluate();
+	if(val1 == NULL || val2 == NULL)
+		return NULL;
 
-			//build new vector with right float value
-			llvm::InsertElementInst *insert = NULL;
-			int i;
-			for(i = 0; i < vecSize; i++)
-			{
+	llvm::Value *cmp = irgen->CreateComparison(op->GetToken(), val1, val2, false);
+	if(cmp->getType()->isVectorTy())
+		cmp = irgen->CreateBuiltin(op->IsOp("==") ? "all" : "any", cmp, false);
 
-				if(i == 0)
-				{
-					if(vecSize == 2)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else if(vecSize == 3)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
+	return llvm::cast<llvm::Constant>(cmp);
+}
 
-				}
-				else
-					insert = llvm::InsertElementInst::Create(insert, valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-			}
-	
-			//calculate subtraction				
-			binInst = llvm::BinaryOperator::CreateFSub(vector, insert, "");
-			bb->getInstList().push_back(binInst);			
+llvm::Value* EqualityExpr::Emit()
+{
+	llvm::Value *val1 = EmitRValue(left);
+	llvm::Value *val2 = EmitRValue(right);
+	llvm::Value *cmp = irgen->CreateComparison(op->GetToken(), val1, val2, false);
 
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;
-			
-		}
-		//vector component
-		else if(llvm::ExtractElementInst::classof(varLeft))
-		{
-			llvm::ExtractElementInst *ext = llvm::dyn_cast<llvm::ExtractElementInst>(varLeft);
+	//vectors are equal when all components are, different when any is
+	if(cmp->getType()->isVectorTy())
+		cmp = irgen->CreateBuiltin(op->IsOp("==") ? "all" : "any", cmp, false);
 
-			//calculate div
-			binInst = llvm::BinaryOperator::CreateFSub(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);
+	return cmp;
+}
 
-			//load vector
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
+llvm::Constant* LogicalExpr::Evaluate()
+{
+	llvm::Constant *val1 = left->Evaluate();
+	llvm::Constant *val2 = right->Evaluate();
+	if(val1 == NULL || val2 == NULL)
+		return NULL;
 
-			//isert value into vector
+	if(op->IsOp("&&"))
+		return llvm::cast<llvm::Constant>(irgen->GetBuilder()->CreateAnd(val1, val2));
 
-			llvm::InsertElementInst *insert = llvm::InsertElementInst::Create(vector, binInst, ext->getIndexOperand(), "", irgen->GetBasicBlock());
+	return llvm::cast<llvm::Constant>(irgen->GetBuilder()->CreateOr(val1, val2));
+}
 
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
-		}
-		//floats
-		else
-		{
-			binInst = llvm::BinaryOperator::CreateFSub(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);
+llvm::Value* LogicalExpr::Emit()
+{
+	llvm::Value *val1 = EmitRValue(left);
+	bool isAnd = op->IsOp("&&");
 
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;
-		}
-	}
-	else if(op->IsOp("+="))
+	//a cheap right side is evaluated anyway, no branch
+	if(IsCheapToSpeculate(right))
 	{
-		//integers
-		if(valType->isIntegerTy())
-		{	
-			binInst = llvm::BinaryOperator::CreateAdd(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);			
-
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;
-		}
-		//shuffle * float
-		else if(llvm::ShuffleVectorInst::classof(varLeft) && valRightFloat)
-		{
-			//get vector
-			llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(varLeft);
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-
-	
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-			
-			llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			
-	
-			llvm::InsertElementInst *insert = NULL;
-			llvm::SmallVector<int, 16>::iterator it = mask.begin();
-			int maskSize = 0;
-
-			//calculate mask size
-			for(it = mask.begin(); it != mask.end(); it++)
-				maskSize++;
-
-			int i = 0;
-			for(it = mask.begin(); it != mask.end(); it++, i++)
-			{
-
-				if(i == 0)
-				{
-					if(maskSize == 2)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else if(maskSize == 3)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-					}
-				else
-					insert = llvm::InsertElementInst::Create(insert, valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					
-			}//end for
-				
-
-			//calculate muliplication
-			binInst = llvm::BinaryOperator::CreateFAdd(valueLeft, insert, "");
-			bb->getInstList().push_back(binInst);			
-
-			//add result to vector
-			i = 0;
-			for(it = mask.begin(); it != mask.end(); it++, i++)
-			{
-				llvm::ExtractElementInst *ext = llvm::ExtractElementInst::Create(binInst, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-				if(i == 0)
-					insert = llvm::InsertElementInst::Create(vector, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-				else
-					insert = llvm::InsertElementInst::Create(insert, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-					
-			}
-
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
-
-		}
-		// shuffle * (shuffle or vector)
-		else if(llvm::ShuffleVectorInst::classof(varLeft) && (llvm::ShuffleVectorInst::classof(varRight) || llvm::VectorType::classof(symbolTable->GetType(varRight)) ))
-		{
-			//get shuffle and vector variable
-			llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(valueLeft);
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-
-			//load vector
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
-
-			//calcualte mult
-			binInst = llvm::BinaryOperator::CreateFAdd(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);
-
-			//get valueLeft's mask from shuffle
-			llvm::SmallVector<int, 16> mask = shuffle->getShuffleMask();
-			llvm::InsertElementInst *insert = NULL;
-				
-
-			//insert into vector
-			int i = 0;
-			for(llvm::SmallVector<int, 16>::iterator it = mask.begin(); it != mask.end(); it++, i++)
-			{
-				llvm::ExtractElementInst *ext = llvm::ExtractElementInst::Create(binInst, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-
-				if(i == 0)
-					insert = llvm::InsertElementInst::Create(vector, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-				else
-					insert = llvm::InsertElementInst::Create(insert, ext, llvm::ConstantInt::get(irgen->GetIntType(), *it), "", irgen->GetBasicBlock());
-			}
-
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
-				
-		}
-		//vector * float
-		else if(llvm::VectorType::classof(symbolTable->GetType(varLeft)) && valRightFloat)
-		{
+		llvm::Value *val2 = EmitRValue(right);
+		if(isAnd)
+			return irgen->GetBuilder()->CreateAnd(val1, val2);
 
-			llvm::LoadInst *vector = new llvm::LoadInst(varLeft, "", irgen->GetBasicBlock());
-			llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(symbolTable->GetType(varLeft));
-			int vecSize = vecType->getNumElements();
+		return irgen->GetBuilder()->CreateOr(val1, val2);
+	}
 
+	//short circuit, the right side only runs when it decides the result
+	llvm::BasicBlock *leftBB = irgen->GetBasicBlock();
+	llvm::BasicBlock *rightBB = llvm::BasicBlock::Create(*(irgen->GetContext()), isAnd ? "AndRhsBB" : "OrRhsBB", irgen->GetFunction());
+	llvm::BasicBlock *mergeBB = llvm::BasicBlock::Create(*(irgen->GetContext()), isAnd ? "AndEndBB" : "OrEndBB", irgen->GetFunction());
 
+	if(isAnd)
+		irgen->GetBuilder()->CreateCondBr(val1, rightBB, mergeBB);
+	else
+		irgen->GetBuilder()->CreateCondBr(val1, mergeBB, rightBB);
 
-			//build new vector with right float value
-			llvm::InsertElementInst *insert = NULL;
-			int i;
-			for(i = 0; i < vecSize; i++)
-			{
+	irgen->SetBasicBlock(rightBB);
+	irgen->SealBlock(rightBB);
+	llvm::Value *val2 = EmitRValue(right);
+	llvm::BasicBlock *rightEndBB = irgen->GetBasicBlock();
+	irgen->GetBuilder()->CreateBr(mergeBB);
 
-				if(i == 0)
-				{
-					if(vecSize == 2)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec2Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else if(vecSize == 3)
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec3Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-					else
-						insert = llvm::InsertElementInst::Create(llvm::UndefValue::get(irgen->GetVec4Type()), valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
+	mergeBB->moveAfter(rightEndBB);
+	irgen->SetBasicBlock(mergeBB);
+	irgen->SealBlock(mergeBB);
 
-				}
-				else
-					insert = llvm::InsertElementInst::Create(insert, valueRight, llvm::ConstantInt::get(irgen->GetIntType(), i), "", irgen->GetBasicBlock());
-				
-			}
-	
-			//calculate mult				
-			binInst = llvm::BinaryOperator::CreateFAdd(vector, insert, "");
-			bb->getInstList().push_back(binInst);			
+	llvm::PHINode *phi = irgen->GetBuilder()->CreatePHI(val1->getType(), 2);
+	phi->addIncoming(llvm::ConstantInt::get(val1->getType(), isAnd ? 0 : 1), leftBB);
+	phi->addIncoming(val2, rightEndBB);
 
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;
-			
-		}
-		//vector component
-		else if(llvm::ExtractElementInst::classof(varLeft))
-		{
-			llvm::ExtractElementInst *ext = llvm::dyn_cast<llvm::ExtractElementInst>(varLeft);
-
-			//calculate div
-			binInst = llvm::BinaryOperator::CreateFAdd(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);
-
-			//load vector
-			char *vecName = dynamic_cast<FieldAccess *>(left)->GetBase();
-			llvm::Value *var = symbolTable->find(vecName)->value;
-			llvm::LoadInst *vector = new llvm::LoadInst(var, "", irgen->GetBasicBlock());
+	return phi;
+}
 
-			//isert value into vector
+void AssignExpr::FoldConstants()
+{
+	//the left side is written, only its subexpressions fold
+	left->FoldConstants();
+	right = Fold(right);
+}
 
-			llvm::InsertElementInst *insert = llvm::InsertElementInst::Create(vector, binInst, ext->getIndexOperand(), "", irgen->GetBasicBlock());
+llvm::Value* AssignExpr::Emit()
+{
+	llvm::Value *valueRight = EmitRValue(right);
+	if(op->IsOp("="))
+		return EmitUpdate(left, NULL, valueRight, false);
 
-			new llvm::StoreInst(insert, var, true, irgen->GetBasicBlock());
-			return binInst;
-		}
-		//float and vector
-		else
-		{
-			binInst = llvm::BinaryOperator::CreateFAdd(valueLeft, valueRight, "");
-			bb->getInstList().push_back(binInst);
+	// "*=" -> "*"
+	std::string binOp(op->GetToken());
+	binOp.erase(binOp.size() - 1);
+	return EmitUpdate(left, binOp.c_str(), valueRight, left->IsUnsigned());
+}
 
-			new llvm::StoreInst(binInst, varLeft, true, irgen->GetBasicBlock());
-			return binInst;
-		}
-	}
-	
+void PostfixExpr::FoldConstants()
+{
+	left->FoldConstants();
 }
 
 llvm::Value* PostfixExpr::Emit()
 {
-	//get llvm value of expr
-	llvm::Value *varRight = left->Emit();
-	llvm::Value *valueRight = varRight;
-
-	llvm::Type *valType = symbolTable->GetType(varRight);
-	llvm::Constant *valLeft;
-	llvm::BinaryOperator *binInst;
-
-
-
-	//load value if necessary
-	if(llvm::AllocaInst::classof(valueRight) || llvm::GlobalVariable::classof(valueRight) || llvm::GetElementPtrInst::classof(valueRight))
-	{
-		valueRight = new llvm::LoadInst(valueRight, "", irgen->GetBasicBlock());
-	}
-
-
-		
-
-	//TODO checking of type not working!
-	if(op->IsOp("++"))
-	{
-		//integer
-		if(valType->isIntegerTy())
-		{	
-			valLeft = llvm::ConstantInt::get(irgen->GetIntType(), 1, true);
-			binInst = llvm::BinaryOperator::CreateAdd(valLeft, valueRight, "");
-
-		}
-		//float
-		else
-		{
-			valLeft = llvm::ConstantFP::get(irgen->GetFloatType(), 1.0);
-			binInst = llvm::BinaryOperator::CreateFAdd(valLeft, valueRight, "");
-		}
-
-	}
-	else if(op->IsOp("--"))
-	{
-
-		//integers
-		if(valType->isIntegerTy())
-		{	
-
-			valLeft = llvm::ConstantInt::get(irgen->GetIntType(), 1, true);
-			binInst = llvm::BinaryOperator::CreateSub(valueRight, valLeft, "");
-		}
-		//float
-		else
-		{
-			valLeft = llvm::ConstantFP::get(irgen->GetFloatType(), 1.0);
-			binInst = llvm::BinaryOperator::CreateFSub(valueRight, valLeft, "");
-		}
-	}
-	
-	irgen->GetBasicBlock()->getInstList().push_back(binInst);
-	new llvm::StoreInst(binInst, varRight, true, irgen->GetBasicBlock());
-	return valueRight;
+	//store the new value, the expression yields the old one
+	return EmitUpdate(left, op->IsOp("++") ? "+" : "-", NULL, IsUnsigned(), true);
 }
 
 ConditionalExpr::ConditionalExpr(Expr *c, Expr *t, Expr *f)
@@ -1923,29 +806,67 @@ ConditionalExpr::ConditionalExpr(Expr *c, Expr *t, Expr *f)
     (falseExpr=f)->SetParent(this);
 }
 
+void ConditionalExpr::FoldConstants()
+{
+	cond = Fold(cond);
+	trueExpr = Fold(trueExpr);
+	falseExpr = Fold(falseExpr);
+}
+
+llvm::Constant* ConditionalExpr::Evaluate()
+{
+	//a constant test picks one side, the other one may be anything
+	llvm::ConstantInt *test = llvm::dyn_cast_or_null<llvm::ConstantInt>(cond->Evaluate());
+	if(test == NULL)
+		return NULL;
+
+	return test->isOne() ? trueExpr->Evaluate() : falseExpr->Evaluate();
+}
+
 llvm::Value* ConditionalExpr::Emit()
 {
 
 
 	//ternary operator
-	llvm::Value *condValue = cond->Emit();
-	llvm::Value *s1Value = trueExpr->Emit();
-	llvm::Value *s2Value = falseExpr->Emit();
-
-	//Perform load if necessary
-	if(llvm::AllocaInst::classof(condValue) || llvm::GlobalVariable::classof(condValue) || llvm::GetElementPtrInst::classof(condValue))
-		condValue = new llvm::LoadInst(condValue, "", irgen->GetBasicBlock());
-		
-	if(llvm::AllocaInst::classof(s1Value) || llvm::GlobalVariable::classof(s1Value) || llvm::GetElementPtrInst::classof(s1Value))
-		s1Value = new llvm::LoadInst(s1Value, "", irgen->GetBasicBlock());
+	llvm::Value *condValue = EmitRValue(cond);
 
-	if(llvm::AllocaInst::classof(s2Value) || llvm::GlobalVariable::classof(s2Value) || llvm::GetElementPtrInst::classof(s2Value))
-		s2Value = new llvm::LoadInst(s2Value, "", irgen->GetBasicBlock());
+	//both arms cheap, evaluate both and select
+	if(IsCheapToSpeculate(trueExpr) && IsCheapToSpeculate(falseExpr))
+	{
+		llvm::Value *s1Value = EmitRValue(trueExpr);
+		llvm::Value *s2Value = EmitRValue(falseExpr);
 
-	
-	llvm::SelectInst  *ternInst = llvm::SelectInst::Create(condValue, s1Value, s2Value, "", irgen->GetBasicBlock());
+		return irgen->GetBuilder()->CreateSelect(condValue, s1Value, s2Value);
+	}
 
-	return ternInst;
+	//otherwise only the arm that is taken runs
+	llvm::BasicBlock *trueBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "CondTrueBB", irgen->GetFunction());
+	llvm::BasicBlock *falseBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "CondFalseBB", irgen->GetFunction());
+	llvm::BasicBlock *mergeBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "CondEndBB", irgen->GetFunction());
+	irgen->GetBuilder()->CreateCondBr(condValue, trueBB, falseBB);
+
+	irgen->SetBasicBlock(trueBB);
+	irgen->SealBlock(trueBB);
+	llvm::Value *s1Value = EmitRValue(trueExpr);
+	llvm::BasicBlock *trueEndBB = irgen->GetBasicBlock();
+	irgen->GetBuilder()->CreateBr(mergeBB);
+
+	falseBB->moveAfter(trueEndBB);
+	irgen->SetBasicBlock(falseBB);
+	irgen->SealBlock(falseBB);
+	llvm::Value *s2Value = EmitRValue(falseExpr);
+	llvm::BasicBlock *falseEndBB = irgen->GetBasicBlock();
+	irgen->GetBuilder()->CreateBr(mergeBB);
+
+	mergeBB->moveAfter(falseEndBB);
+	irgen->SetBasicBlock(mergeBB);
+	irgen->SealBlock(mergeBB);
+
+	llvm::PHINode *phi = irgen->GetBuilder()->CreatePHI(s1Value->getType(), 2);
+	phi->addIncoming(s1Value, trueEndBB);
+	phi->addIncoming(s2Value, falseEndBB);
+
+	return phi;
 }
 
 void ConditionalExpr::PrintChildren(int indentLevel) {
@@ -1953,19 +874,58 @@ void ConditionalExpr::PrintChildren(int indentLevel) {
     trueExpr->Print(indentLevel+1, "(true) ");
     falseExpr->Print(indentLevel+1, "(false) ");
 }
+
+void ConditionalExpr::WalkChildren(NodeVisitor *visitor) {
+    cond->Walk(visitor);
+    trueExpr->Walk(visitor);
+    falseExpr->Walk(visitor);
+}
+
 ArrayAccess::ArrayAccess(yyltype loc, Expr *b, Expr *s) : LValue(loc) {
     (base=b)->SetParent(this); 
     (subscript=s)->SetParent(this);
 }
 
 llvm::Value* ArrayAccess::Emit()
+{
+	llvm::Value *index;
+	llvm::Value *llvmBase = EmitBase(index);
+
+	return EmitElement(llvmBase, index);
+}
+
+llvm::Value* ArrayAccess::EmitBase(llvm::Value *&index)
 {
 	llvm::Value *llvmBase = base->Emit();
-	llvm::Value *index = subscript->Emit();
+	index = subscript->Emit();
 
 	//load index if variable
-	if(llvm::AllocaInst::classof(index) || llvm::GlobalVariable::classof(index) || llvm::GetElementPtrInst::classof(index))
-		index = new llvm::LoadInst(index, "", irgen->GetBasicBlock());
+	if(index->getType()->isPointerTy())
+		index = irgen->CreateLoad(index);
+
+	return llvmBase;
+}
+
+llvm::Value* ArrayAccess::EmitElement(llvm::Value *llvmBase, llvm::Value *index)
+{
+	//vector local in a register, it has no address to index
+	if(irgen->IsSSAVariable(llvmBase))
+		return irgen->GetBuilder()->CreateExtractElement(irgen->CreateLoad(llvmBase), index);
+
+	//a vector or matrix value (call result, folded constant) has no address
+	if(!llvmBase->getType()->isPointerTy())
+	{
+		if(llvmBase->getType()->isVectorTy())
+			return irgen->GetBuilder()->CreateExtractElement(llvmBase, index);
+
+		if(llvm::ConstantInt *constIndex = llvm::dyn_cast<llvm::ConstantInt>(index))
+			return irgen->GetBuilder()->CreateExtractValue(llvmBase, constIndex->getZExtValue());
+
+		//variable column, index a temporary copy
+		llvm::Value *copy = irgen->CreateLocal(llvmBase->getType(), "", false);
+		irgen->CreateStore(llvmBase, copy);
+		llvmBase = copy;
+	}
 
 	//construct array access param
 	std::vector<llvm::Value*> v;
@@ -1973,7 +933,7 @@ llvm::Value* ArrayAccess::Emit()
 	v.push_back(index);
 	
 	llvm::ArrayRef<llvm::Value*> indxArray(v);
-	llvm::GetElementPtrInst *gep = llvm::GetElementPtrInst::CreateInBounds(llvmBase, indxArray, llvmBase->getName(), irgen->GetBasicBlock());
+	llvm::Value *gep = irgen->GetBuilder()->CreateInBoundsGEP(llvmBase, indxArray, llvmBase->getName());
 
 	return gep;
 }
@@ -1982,6 +942,59 @@ void ArrayAccess::PrintChildren(int indentLevel) {
     base->Print(indentLevel+1);
     subscript->Print(indentLevel+1, "(subscript) ");
 }
+
+void ArrayAccess::WalkChildren(NodeVisitor *visitor) {
+    base->Walk(visitor);
+    subscript->Walk(visitor);
+}
+
+bool ArrayAccess::IsInBounds()
+{
+	llvm::ConstantInt *index = llvm::dyn_cast_or_null<llvm::ConstantInt>(subscript->Evaluate());
+	VarExpr *var = dynamic_cast<VarExpr *>(base);
+	if(index == NULL || var == NULL)
+		return false;
+
+	Symbol *sym = symbolTable->find(var->GetIdentifier()->GetName());
+	if(sym == NULL || sym->value == NULL)
+		return false;
+
+	//arrays and matrices live in memory, a const vector may be a value
+	llvm::Type *type = sym->value->getType();
+	if(type->isPointerTy())
+		type = type->getPointerElementType();
+
+	uint64_t count;
+	if(llvm::ArrayType *arrayType = llvm::dyn_cast<llvm::ArrayType>(type))
+		count = arrayType->getNumElements();
+	else if(llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(type))
+		count = vecType->getNumElements();
+	else
+		return false;
+
+	//negative subscripts are huge unsigned
+	return index->getZExtValue() < count;
+}
+
+llvm::Constant* ArrayAccess::Evaluate()
+{
+	//element of a const array, matrix or vector at a constant index
+	llvm::Constant *value = base->Evaluate();
+	llvm::ConstantInt *index = llvm::dyn_cast_or_null<llvm::ConstantInt>(subscript->Evaluate());
+	if(value == NULL || index == NULL)
+		return NULL;
+
+	if(value->getType()->isVectorTy())
+		return llvm::cast<llvm::Constant>(irgen->GetBuilder()->CreateExtractElement(value, index));
+
+	return llvm::cast<llvm::Constant>(irgen->GetBuilder()->CreateExtractValue(value, index->getZExtValue()));
+}
+
+void ArrayAccess::FoldConstants()
+{
+	base->FoldConstants();
+	subscript = Fold(subscript);
+}
      
 FieldAccess::FieldAccess(Expr *b, Identifier *f) 
   : LValue(b? Join(b->GetLocation(), f->GetLocation()) : *f->GetLocation()) {
@@ -1997,63 +1010,76 @@ void FieldAccess::PrintChildren(int indentLevel) {
     field->Print(indentLevel+1);
 }
 
-llvm::Value* FieldAccess::Emit()
+void FieldAccess::WalkChildren(NodeVisitor *visitor) {
+    if (base) base->Walk(visitor);
+}
+
+void FieldAccess::FoldConstants()
 {
+	//the base may be written through the swizzle, Evaluate() reads it
+	if(base != NULL)
+		base->FoldConstants();
+}
 
-	//load variable
-	llvm::Value *vector = base->Emit();
+llvm::SmallVector<int, 16> FieldAccess::GetMask()
+{
+	llvm::SmallVector<int, 16> mask;
+	for(char *c = field->GetName(); *c != '\0'; c++)
+	{
+		if(*c == 'x')
+			mask.push_back(0);
+		else if(*c == 'y')
+			mask.push_back(1);
+		else if(*c == 'z')
+			mask.push_back(2);
+		else
+			mask.push_back(3);
+	}
 
-	if(llvm::AllocaInst::classof(vector) || llvm::GlobalVariable::classof(vector))
-		vector = new llvm::LoadInst(vector, "", irgen->GetBasicBlock());
+	return mask;
+}
 
-	//get field length
-	char *fieldStr = field->GetName();
-	int fieldLen = 0;
-	for(int i = 0; fieldStr[i] != '\0'; i++)
-		fieldLen++;
+llvm::Value* FieldAccess::EmitBase(llvm::SmallVector<int, 16> &mask)
+{
+	llvm::SmallVector<int, 16> fieldMask = GetMask();
 
-	if(fieldLen == 1)
+	//swizzle of a swizzle, select through the inner mask
+	FieldAccess *inner = dynamic_cast<FieldAccess *>(base);
+	if(inner != NULL)
 	{
-		//find index
-		llvm::Constant *index;
-		if(fieldStr[0] == 'x')
-			index = llvm::ConstantInt::get(irgen->GetIntType(), 0);
-		else if(fieldStr[0] == 'y')
-			index = llvm::ConstantInt::get(irgen->GetIntType(), 1);
-		else if(fieldStr[0] == 'z')
-			index = llvm::ConstantInt::get(irgen->GetIntType(), 2);
-		else
-			index = llvm::ConstantInt::get(irgen->GetIntType(), 3);
+		llvm::SmallVector<int, 16> innerMask;
+		llvm::Value *vector = inner->EmitBase(innerMask);
+
+		mask.clear();
+		for(int i = 0; i < fieldMask.size(); i++)
+			mask.push_back(innerMask[fieldMask[i]]);
 
-		//extract element
-		llvm::ExtractElementInst *ext = llvm::ExtractElementInst::Create(vector, index, "", irgen->GetBasicBlock());
-		return ext;
+		return vector;
 	}
-	else
-	{
-		//build mask
-		std::vector<llvm::Constant*> idxVec;
-		for(int i = 0; i < fieldLen; i++)
-		{
-			if(fieldStr[i] == 'x')
-				idxVec.push_back(llvm::ConstantInt::get(irgen->GetIntType(), 0));
-			else if(fieldStr[i] == 'y')
-				idxVec.push_back(llvm::ConstantInt::get(irgen->GetIntType(), 1));
-			else if(fieldStr[i] == 'z')
-				idxVec.push_back(llvm::ConstantInt::get(irgen->GetIntType(), 2));
-			else
-				idxVec.push_back(llvm::ConstantInt::get(irgen->GetIntType(), 3));
 
-		}
+	mask = fieldMask;
+	return base->Emit();
+}
 
+llvm::Value* FieldAccess::Emit()
+{
+	llvm::SmallVector<int, 16> mask;
+	llvm::Value *vector = EmitBase(mask);
 
-		llvm::ArrayRef<llvm::Constant*> idxArray(idxVec);
-		llvm::Constant *mask = llvm::ConstantVector::get(idxArray);
+	//load variable
+	if(vector->getType()->isPointerTy())
+		vector = irgen->CreateLoad(vector);
 
-		return new llvm::ShuffleVectorInst(vector, vector, mask, "", irgen->GetBasicBlock());
-	}
+	return irgen->CreateSwizzle(vector, mask);
+}
 
-	
+llvm::Constant* FieldAccess::Evaluate()
+{
+	llvm::Constant *vector = base ? base->Evaluate() : NULL;
+	if(vector == NULL)
+		return NULL;
+
+	return llvm::cast<llvm::Constant>(irgen->CreateSwizzle(vector, GetMask()));
 }
 
 
@@ -2076,22 +1102,164 @@ llvm::Value* Call::Emit()
 	for(int i = 0; i < actuals->NumElements(); i++)
 	{
 		llvm::Value *value = actuals->Nth(i)->Emit();
-		if(llvm::AllocaInst::classof(value) || llvm::GlobalVariable::classof(value) || llvm::GetElementPtrInst::classof(value))
-			value = new llvm::LoadInst(value, "", irgen->GetBasicBlock());
+		if(value->getType()->isPointerTy())
+			value = irgen->CreateLoad(value);
 
 		vecArgs.push_back(value);
 	}
 	llvm::ArrayRef<llvm::Value*> argsArray(vecArgs);
 
-	//create call
-	llvm::CallInst *call = llvm::CallInst::Create(func, argsArray, field->GetName(), irgen->GetBasicBlock());
+	//no user function by that name, lower the built-in inline
+	if(func == NULL)
+	{
+		bool isUnsigned = actuals->NumElements() > 0 && actuals->Nth(0)->IsUnsigned();
+		llvm::Value *builtin = irgen->CreateBuiltin(field->GetName(), argsArray, isUnsigned);
+		Assert(builtin != NULL);
+		return builtin;
+	}
+
+	//create call, void results can not be named
+	const char *name = func->getReturnType()->isVoidTy() ? "" : field->GetName();
+	llvm::Value *call = irgen->GetBuilder()->CreateCall(func, argsArray, name);
 
 	return call;
 }
 
+llvm::Constant* Call::Evaluate()
+{
+	//built-ins with constant arguments, user functions run at run time
+	if(IsUserFunction() || irgen->GetBuiltinArgCount(field->GetName()) != actuals->NumElements())
+		return NULL;
+
+	std::vector<llvm::Value *> values;
+	for(int i = 0; i < actuals->NumElements(); i++)
+	{
+		llvm::Constant *value = actuals->Nth(i)->Evaluate();
+		if(value == NULL)
+			return NULL;
+
+		values.push_back(value);
+	}
+
+	return llvm::dyn_cast_or_null<llvm::Constant>(irgen->CreateBuiltin(field->GetName(), values, IsUnsigned()));
+}
+
+bool Call::IsUnsigned()
+{
+	//built-ins follow their first argument
+	return actuals->NumElements() > 0 && actuals->Nth(0)->IsUnsigned();
+}
+
 void Call::PrintChildren(int indentLevel) {
    if (base) base->Print(indentLevel+1);
    if (field) field->Print(indentLevel+1);
    if (actuals) actuals->PrintAll(indentLevel+1, "(actuals) ");
 }
 
+void Call::WalkChildren(NodeVisitor *visitor) {
+   if (base) base->Walk(visitor);
+   if (actuals) actuals->WalkAll(visitor);
+}
+
+void Call::FoldConstants()
+{
+	for(int i = 0; i < actuals->NumElements(); i++)
+		actuals->SetNth(i, Fold(actuals->Nth(i)));
+
+	if(IsUserFunction())
+		return;
+
+	int numArgs = irgen->GetBuiltinArgCount(field->GetName());
+	if(numArgs < 0)
+		ReportError::Formatted(GetLocation(), "No function named '%s'", field->GetName());
+	else if(numArgs != actuals->NumElements())
+		ReportError::Formatted(GetLocation(), "Built-in '%s' needs %d arguments, %d given", field->GetName(), numArgs, actuals->NumElements());
+}
+
+bool Call::IsUserFunction()
+{
+	//user functions are entered by FnDecl::FoldConstants and hide
+	//built-ins of the same name
+	Symbol *sym = constTable->findGlobal(field->GetName());
+	return sym != NULL && sym->kind == E_FunctionDecl;
+}
+
+ConstructorExpr::ConstructorExpr(yyltype loc, Type *t, List<Expr*> *a) : Expr(loc) {
+    Assert(t != NULL && a != NULL);
+    (type=t)->SetParent(this);
+    (args=a)->SetParentAll(this);
+}
+
+void ConstructorExpr::PrintChildren(int indentLevel) {
+    type->Print(indentLevel+1);
+    args->PrintAll(indentLevel+1, "(args) ");
+}
+
+void ConstructorExpr::WalkChildren(NodeVisitor *visitor) {
+    args->WalkAll(visitor);
+}
+
+void ConstructorExpr::FoldConstants()
+{
+	for(int i = 0; i < args->NumElements(); i++)
+		args->SetNth(i, Fold(args->Nth(i)));
+
+	//reported here, Program::Emit stops before any code is generated
+	if(HasWrongCount())
+		ReportError::Formatted(GetLocation(), "Array constructor needs %d arguments, %d given", dynamic_cast<ArrayType *>(type)->GetElemCount(), args->NumElements());
+}
+
+bool ConstructorExpr::HasWrongCount()
+{
+	ArrayType *arrayType = dynamic_cast<ArrayType *>(type);
+	return arrayType != NULL && arrayType->GetElemCount() != args->NumElements();
+}
+
+llvm::Value* ConstructorExpr::Construct(const std::vector<llvm::Value *> &values)
+{
+	//float(u) and uint(f) convert as unsigned
+	bool isUnsigned = type->IsUnsigned();
+	for(int i = 0; i < args->NumElements(); i++)
+		isUnsigned = isUnsigned || args->Nth(i)->IsUnsigned();
+
+	llvm::Type *llvmType = type->typeToLlvmType();
+	ArrayType *arrayType = dynamic_cast<ArrayType *>(type);
+	if(arrayType != NULL)
+		return irgen->CreateArrayConstructor(llvm::cast<llvm::ArrayType>(llvmType), values, isUnsigned);
+
+	return irgen->CreateConstructor(llvmType, values, isUnsigned);
+}
+
+llvm::Constant* ConstructorExpr::Evaluate()
+{
+	if(HasWrongCount())
+		return NULL;
+
+	std::vector<llvm::Value *> values;
+	for(int i = 0; i < args->NumElements(); i++)
+	{
+		llvm::Constant *value = args->Nth(i)->Evaluate();
+		if(value == NULL)
+			return NULL;
+
+		values.push_back(value);
+	}
+
+	return llvm::cast<llvm::Constant>(Construct(values));
+}
+
+llvm::Value* ConstructorExpr::Emit()
+{
+	std::vector<llvm::Value *> values;
+	for(int i = 0; i < args->NumElements(); i++)
+	{
+		llvm::Value *value = args->Nth(i)->Emit();
+		if(value->getType()->isPointerTy())
+			value = irgen->CreateLoad(value);
+
+		values.push_back(value);
+	}
+
+	return Construct(values);
+}
+
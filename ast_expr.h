@@ -31,6 +31,28 @@ class Expr : public Stmt
     }
 
 	virtual llvm::Value* Emit() { return llvm::UndefValue::get(irgen->GetVoidType()); }
+
+	//value of the expression if it is known at compile time, else NULL
+	virtual llvm::Constant* Evaluate() { return NULL; }
+
+	//fold the children of expr, then replace expr by its value if it has one
+	static Expr* Fold(Expr *expr);
+
+	//value of expr, loaded if it is a variable
+	static llvm::Value* EmitRValue(Expr *expr);
+
+	//read-modify-write of the variable, element or swizzle lvalue names:
+	//one address, one load, lvalue op operand, one store.  A NULL op
+	//stores operand as is, a NULL operand stands for 1 (++ and --).
+	//Returns the value stored, or with postfix the value before
+	static llvm::Value* EmitUpdate(Expr *lvalue, const char *op, llvm::Value *operand, bool isUnsigned, bool postfix = false);
+
+	//true if expr has no side effects and is cheap enough to evaluate
+	//even when its value is not needed (-select-threshold=<n>)
+	static bool IsCheapToSpeculate(Expr *expr);
+
+	//uint and uvec values take the unsigned divide and compares
+	virtual bool IsUnsigned() { return false; }
 };
 
 class ExprError : public Expr
@@ -49,6 +71,24 @@ class EmptyExpr : public Expr
     const char *GetPrintNameForNode() { return "Empty"; }
 };
 
+/* Result of FoldConstants: a subexpression whose value was computed at
+ * compile time, vectors included. */
+class FoldedConstant : public Expr
+{
+  protected:
+    llvm::Constant *value;
+    bool isUnsigned;
+
+  public:
+    FoldedConstant(Expr *original, llvm::Constant *val);
+    const char *GetPrintNameForNode() { return "FoldedConstant"; }
+    void PrintChildren(int indentLevel);
+
+	llvm::Constant* Evaluate() { return value; }
+	llvm::Value* Emit() { return value; }
+	bool IsUnsigned() { return isUnsigned; }
+};
+
 class IntConstant : public Expr 
 {
   protected:
@@ -59,6 +99,7 @@ class IntConstant : public Expr
     const char *GetPrintNameForNode() { return "IntConstant"; }
     void PrintChildren(int indentLevel);
 
+	llvm::Constant* Evaluate() { return llvm::cast<llvm::Constant>(Emit()); }
 	llvm::Value* Emit();
 };
 
@@ -72,6 +113,7 @@ class FloatConstant: public Expr
     const char *GetPrintNameForNode() { return "FloatConstant"; }
     void PrintChildren(int indentLevel);
 
+	llvm::Constant* Evaluate() { return llvm::cast<llvm::Constant>(Emit()); }
 	llvm::Value* Emit();
 };
 
@@ -85,6 +127,7 @@ class BoolConstant : public Expr
     const char *GetPrintNameForNode() { return "BoolConstant"; }
     void PrintChildren(int indentLevel);
 
+	llvm::Constant* Evaluate() { return llvm::cast<llvm::Constant>(Emit()); }
 	llvm::Value* Emit();
 };
 
@@ -92,6 +135,7 @@ class VarExpr : public Expr
 {
   protected:
     Identifier *id;
+    bool isUnsigned;
 
   public:
     VarExpr(yyltype loc, Identifier *id);
@@ -99,7 +143,14 @@ class VarExpr : public Expr
     void PrintChildren(int indentLevel);
     Identifier *GetIdentifier() {return id;}
 
+	void FoldConstants();
+
+	llvm::Constant* Evaluate();
 	llvm::Value* Emit();
+	bool IsUnsigned() { return isUnsigned; }
+
+	//type of the value the variable holds, without emitting anything
+	llvm::Type* GetValueType();
 };
 
 class Operator : public Node 
@@ -113,6 +164,7 @@ class Operator : public Node
     void PrintChildren(int indentLevel);
     friend ostream& operator<<(ostream& out, Operator *o) { return out << o->tokenString; }
     bool IsOp(const char *op) const;
+    const char *GetToken() const { return tokenString; }
 	
 	
  };
@@ -128,8 +180,14 @@ class CompoundExpr : public Expr
     CompoundExpr(Operator *op, Expr *rhs);             // for unary
     CompoundExpr(Expr *lhs, Operator *op);             // for unary
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
+    Operator *GetOp() const { return op; }
+    Expr *GetLeft() const { return left; }
+    Expr *GetRight() const { return right; }
+    void FoldConstants();
 	
 	virtual llvm::Value* Emit() { return llvm::UndefValue::get(irgen->GetVoidType()); }
+	bool IsUnsigned();
 };
 
 class ArithmeticExpr : public CompoundExpr 
@@ -138,8 +196,17 @@ class ArithmeticExpr : public CompoundExpr
     ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
     const char *GetPrintNameForNode() { return "ArithmeticExpr"; }
+    void FoldConstants();
 
+	llvm::Constant* Evaluate();
 	llvm::Value* Emit();
+	bool IsUnsigned();
+
+  protected:
+	llvm::Value* EmitContracted();
+	llvm::Value* EmitScalarsFirst();
+	llvm::Value* EmitReduction();
+	llvm::Value* EmitAsWritten(const std::vector<llvm::Value *> &values, unsigned &next);
 };
 
 class RelationalExpr : public CompoundExpr 
@@ -148,7 +215,9 @@ class RelationalExpr : public CompoundExpr
     RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "RelationalExpr"; }
 	
+	llvm::Constant* Evaluate();
 	llvm::Value* Emit();
+	bool IsUnsigned() { return false; }
 };
 
 class EqualityExpr : public CompoundExpr 
@@ -157,7 +226,9 @@ class EqualityExpr : public CompoundExpr
     EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "EqualityExpr"; }
 
+	llvm::Constant* Evaluate();
 	llvm::Value* Emit();
+	bool IsUnsigned() { return false; }
 };
 
 class LogicalExpr : public CompoundExpr 
@@ -167,7 +238,9 @@ class LogicalExpr : public CompoundExpr
     LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
     const char *GetPrintNameForNode() { return "LogicalExpr"; }
 
+	llvm::Constant* Evaluate();
 	llvm::Value* Emit();
+	bool IsUnsigned() { return false; }
 };
 
 class AssignExpr : public CompoundExpr 
@@ -175,6 +248,7 @@ class AssignExpr : public CompoundExpr
   public:
     AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "AssignExpr"; }
+    void FoldConstants();
 
 	llvm::Value* Emit();
 };
@@ -184,6 +258,7 @@ class PostfixExpr : public CompoundExpr
   public:
     PostfixExpr(Expr *lhs, Operator *op) : CompoundExpr(lhs,op) {}
     const char *GetPrintNameForNode() { return "PostfixExpr"; }
+    void FoldConstants();
 
 	llvm::Value* Emit();
 
@@ -196,9 +271,13 @@ class ConditionalExpr : public Expr
   public:
     ConditionalExpr(Expr *c, Expr *t, Expr *f);
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
     const char *GetPrintNameForNode() { return "ConditionalExpr"; }
+    void FoldConstants();
 
+	llvm::Constant* Evaluate();
 	llvm::Value* Emit();
+	bool IsUnsigned() { return trueExpr->IsUnsigned(); }
 };
 
 class LValue : public Expr 
@@ -216,8 +295,20 @@ class ArrayAccess : public LValue
     ArrayAccess(yyltype loc, Expr *base, Expr *subscript);
     const char *GetPrintNameForNode() { return "ArrayAccess"; }
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
 
+	llvm::Constant* Evaluate();
 	llvm::Value* Emit();
+	bool IsUnsigned() { return base->IsUnsigned(); }
+
+	//base and loaded subscript, then the element: its address, or its
+	//value for a vector kept in a register
+	llvm::Value* EmitBase(llvm::Value *&index);
+	llvm::Value* EmitElement(llvm::Value *llvmBase, llvm::Value *index);
+
+	//constant subscript of a variable, inside its bounds
+	bool IsInBounds();
 };
 
 /* Note that field access is used both for qualified names
@@ -235,10 +326,19 @@ class FieldAccess : public LValue
     FieldAccess(Expr *base, Identifier *field); //ok to pass NULL base
     const char *GetPrintNameForNode() { return "FieldAccess"; }
     void PrintChildren(int indentLevel);
-	char* GetBase() { return dynamic_cast<VarExpr *>(base)->GetIdentifier()->GetName();}
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
 	char* GetField(){ return field->GetName(); }
+	Expr *GetBase() { return base; }
+	llvm::SmallVector<int, 16> GetMask();	//component index per field letter
 
+	//vector the swizzle selects from (an address when it is an lvalue),
+	//chained swizzles are folded into one mask: v.zyx.xy -> v, (2, 1)
+	llvm::Value* EmitBase(llvm::SmallVector<int, 16> &mask);
+
+	llvm::Constant* Evaluate();
 	llvm::Value* Emit();
+	bool IsUnsigned() { return base != NULL && base->IsUnsigned(); }
 };
 
 /* Like field access, call is used both for qualified base.field()
@@ -256,9 +356,41 @@ class Call : public Expr
     Call() : Expr(), base(NULL), field(NULL), actuals(NULL) {}
     Call(yyltype loc, Expr *base, Identifier *field, List<Expr*> *args);
     const char *GetPrintNameForNode() { return "Call"; }
+    Identifier *GetField() const { return field; }
+    void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
+
+	llvm::Constant* Evaluate();
+	llvm::Value* Emit();
+	bool IsUnsigned();
+
+  private:
+	bool IsUserFunction();
+};
+
+/* Constructor of a built-in type: vec3(1.0, 2.0, 3.0), vec4(v.xy, 0.0, 1.0),
+ * vec2(0.5) or float(i).  Components are taken from the arguments in order
+ * and converted to the component type of the result. */
+class ConstructorExpr : public Expr
+{
+  protected:
+    Type *type;
+    List<Expr*> *args;
+
+	llvm::Value* Construct(const std::vector<llvm::Value *> &values);
+	bool HasWrongCount();	//array constructor with too few or too many arguments
+
+  public:
+    ConstructorExpr(yyltype loc, Type *type, List<Expr*> *args);
+    const char *GetPrintNameForNode() { return "ConstructorExpr"; }
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
 
+	llvm::Constant* Evaluate();
 	llvm::Value* Emit();
+	bool IsUnsigned() { return type->IsUnsigned(); }
 };
 
 class ActualsError : public Call
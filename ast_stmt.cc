@@ -7,7 +7,10 @@
 #include "ast_decl.h"
 #include "ast_expr.h"
 #include "symtable.h"
+#include "passes.h"
 #include <string>
+#include <map>
+#include <vector>
 
 #include "irgen.h"
 #include "llvm/Bitcode/ReaderWriter.h"
@@ -25,6 +28,81 @@ void Program::PrintChildren(int indentLevel) {
     printf("\n");
 }
 
+void Program::WalkChildren(NodeVisitor *visitor) {
+    decls->WalkAll(visitor);
+}
+
+void Program::FoldConstants()
+{
+	for(int i = 0; i < decls->NumElements(); i++)
+		decls->Nth(i)->FoldConstants();
+}
+
+//names a declaration refers to: the functions it calls and the variables
+//it reads or writes
+class ReferenceFinder : public NodeVisitor
+{
+  public:
+    std::vector<const char *> names;
+
+    void Visit(Node *node);
+};
+
+void ReferenceFinder::Visit(Node *node)
+{
+	VarExpr *var = dynamic_cast<VarExpr *>(node);
+	Call *call = dynamic_cast<Call *>(node);
+
+	if(var != NULL)
+		names.push_back(var->GetIdentifier()->GetName());
+	else if(call != NULL)
+		names.push_back(call->GetField()->GetName());
+}
+
+void Program::FindReachable(std::set<Decl*> &reachable)
+{
+	std::map<std::string, Decl*> byName;
+	for(int i = 0; i < decls->NumElements(); i++)
+		byName[decls->Nth(i)->GetIdentifier()->GetName()] = decls->Nth(i);
+
+	//entry points, comma separated
+	std::vector<Decl*> worklist;
+	std::string entries(GetOption("entry"));
+	size_t start = 0;
+	while(start <= entries.size())
+	{
+		size_t end = entries.find(',', start);
+		if(end == std::string::npos)
+			end = entries.size();
+
+		std::string name = entries.substr(start, end - start);
+		std::map<std::string, Decl*>::iterator decl = byName.find(name);
+		if(decl == byName.end() || dynamic_cast<FnDecl *>(decl->second) == NULL)
+			Failure("No function '%s' to use as --entry", name.c_str());
+
+		worklist.push_back(decl->second);
+		start = end + 1;
+	}
+
+	//a local that shadows a global keeps the global alive, which is safe
+	while(!worklist.empty())
+	{
+		Decl *decl = worklist.back();
+		worklist.pop_back();
+		if(!reachable.insert(decl).second)
+			continue;
+
+		ReferenceFinder finder;
+		decl->Walk(&finder);
+		for(unsigned i = 0; i < finder.names.size(); i++)
+		{
+			std::map<std::string, Decl*>::iterator ref = byName.find(finder.names[i]);
+			if(ref != byName.end())
+				worklist.push_back(ref->second);
+		}
+	}
+}
+
 llvm::Value* Program::Emit() {
     // TODO:
     // This is just a reference for you to get started
@@ -35,14 +113,38 @@ llvm::Value* Program::Emit() {
     //IRGenerator irgen;
     llvm::Module *mod = irgen->GetOrCreateModule("Name_the_Module.bc");
 
+	//evaluate constant expressions and const variables before any IR exists
+	FoldConstants();
+
+	//errors found while folding, no bitcode for an invalid program
+	if(ReportError::NumErrors() > 0)
+		return llvm::UndefValue::get(irgen->GetVoidType());
+
+	//with --entry only what the entry points reach is generated
+	std::set<Decl*> reachable;
+	bool hasEntries = GetOption("entry") != NULL;
+	if(hasEntries)
+		FindReachable(reachable);
+
 	//Generate code for all declarations
 	for(int i = 0; i < decls->NumElements(); i++)
 	{
 		Decl *decl = decls->Nth(i);
+		if(hasEntries && reachable.count(decl) == 0)
+		{
+			PrintDebug("entry", "%s is not reachable, dropped", decl->GetIdentifier()->GetName());
+			continue;
+		}
 
 		decl->Emit();
 	}
 
+	if(hasEntries)
+	{
+		PrintStat("%d of %d declarations dropped", decls->NumElements() - (int)reachable.size(), decls->NumElements());
+		InternalizeModule(mod, GetOption("entry"));
+	}
+
 /*------------- EXAMPLES----------------------
 
     // create a function signature
@@ -66,6 +168,18 @@ llvm::Value* Program::Emit() {
     llvm::Value *sum = llvm::BinaryOperator::CreateAdd(arg, val, "", bb);
     llvm::ReturnInst::Create(*context, sum, bb);
 */
+    // bake the uniform values given with -specialize into the code
+    if(GetOption("specialize") != NULL)
+        SpecializeUniforms(mod, GetOption("specialize"));
+
+    // purity attributes over the call graph, then inline small helpers
+    InferFunctionAttributes(mod);
+    InlineFunctions(mod);
+
+    // run the optimization pipeline selected on the command line
+    OptimizeModule(mod);
+    ReportPromotableAllocas(mod);
+
     // write the BC into standard output
     llvm::WriteBitcodeToFile(mod, llvm::outs());
 
@@ -86,10 +200,99 @@ void StmtBlock::PrintChildren(int indentLevel) {
     stmts->PrintAll(indentLevel+1);
 }
 
+void StmtBlock::WalkChildren(NodeVisitor *visitor) {
+    decls->WalkAll(visitor);
+    stmts->WalkAll(visitor);
+}
+
+void StmtBlock::FoldConstants()
+{
+	constTable->push();
+
+	for(int i = 0; i < decls->NumElements(); i++)
+		decls->Nth(i)->FoldConstants();
+
+	for(int i = 0; i < stmts->NumElements(); i++)
+		stmts->Nth(i)->FoldConstants();
+
+	constTable->pop();
+}
+
+//variable written by a plain assignment to a component or swizzle of it,
+//v.x = ... or v.zy = ..., else NULL
+static VarExpr *SwizzleStoreTarget(Stmt *stmt)
+{
+	AssignExpr *assign = dynamic_cast<AssignExpr *>(stmt);
+	if(assign == NULL || !assign->GetOp()->IsOp("="))
+		return NULL;
+
+	FieldAccess *field = dynamic_cast<FieldAccess *>(assign->GetLeft());
+	if(field == NULL)
+		return NULL;
+
+	return dynamic_cast<VarExpr *>(field->GetBase());
+}
+
+int StmtBlock::EmitCombinedStores(int first)
+{
+	VarExpr *target = SwizzleStoreTarget(stmts->Nth(first));
+	if(target == NULL)
+		return 0;
+	const char *name = target->GetIdentifier()->GetName();
+
+	//extend the run while the right sides neither read the vector nor
+	//call a function that might
+	llvm::Module *mod = irgen->GetOrCreateModule("Module");
+	int last = first;
+	while(last + 1 < stmts->NumElements())
+	{
+		Stmt *stmt = stmts->Nth(last + 1);
+		VarExpr *next = SwizzleStoreTarget(stmt);
+		if(next == NULL || strcmp(next->GetIdentifier()->GetName(), name) != 0)
+			break;
+
+		ReferenceFinder finder;
+		dynamic_cast<AssignExpr *>(stmt)->GetRight()->Walk(&finder);
+		bool reads = false;
+		for(unsigned i = 0; i < finder.names.size() && !reads; i++)
+			reads = strcmp(finder.names[i], name) == 0 || mod->getFunction(finder.names[i]) != NULL;
+		if(reads)
+			break;
+
+		last++;
+	}
+
+	//volatile variables keep every store
+	if(last == first || irgen->IsVolatile(target->Emit()))
+		return 0;
+
+	//the first right side runs before the load, like a single assignment
+	llvm::Value *var = NULL;
+	llvm::Value *vector = NULL;
+	for(int i = first; i <= last; i++)
+	{
+		AssignExpr *assign = dynamic_cast<AssignExpr *>(stmts->Nth(i));
+		llvm::Value *value = Expr::EmitRValue(assign->GetRight());
+
+		llvm::SmallVector<int, 16> mask;
+		var = dynamic_cast<FieldAccess *>(assign->GetLeft())->EmitBase(mask);
+		if(vector == NULL)
+			vector = irgen->CreateLoad(var);
+
+		vector = irgen->CreateSwizzleBlend(vector, value, mask);
+	}
+	irgen->CreateStore(vector, var);
+
+	PrintStat("%d stores to %s at line %d combined", last - first + 1, name, target->GetLocation() ? target->GetLocation()->first_line : 0);
+	return last - first + 1;
+}
+
 llvm::Value* StmtBlock::Emit()
 {
-	
-	
+	//every block is a scope, like in FoldConstants; if/else, loop and case
+	//bodies are blocks too, so their locals cannot leak into a sibling
+	symbolTable->push();
+
 	//var decls
 	for(int i = 0; i < decls->NumElements(); i++)
 	{
@@ -100,23 +303,21 @@ llvm::Value* StmtBlock::Emit()
 	//statements
 	for(int i = 0; i < stmts->NumElements(); i++)
 	{
+		//runs of component writes to one vector are stored once
+		int combined = EmitCombinedStores(i);
+		if(combined > 0)
+		{
+			i += combined - 1;
+			continue;
+		}
+
 		Stmt *stmt = stmts->Nth(i);
 		//std::cerr << stmt->GetPrintNameForNode() << std::endl;
 
-		//push new scope if block stmt is found
-		StmtBlock *stmtBlock = dynamic_cast<StmtBlock *>(stmt);
-		if(stmtBlock != NULL)
-		{
-			symbolTable->push();
-	
-			stmt->Emit();
-	
-			symbolTable->pop();
-		}
-		else	
-			stmt->Emit();
+		stmt->Emit();
 	}
 
+	symbolTable->pop();
 
 	return llvm::UndefValue::get(irgen->GetVoidType());
 }
@@ -130,6 +331,15 @@ void DeclStmt::PrintChildren(int indentLevel) {
     decl->Print(indentLevel+1);
 }
 
+void DeclStmt::WalkChildren(NodeVisitor *visitor) {
+    decl->Walk(visitor);
+}
+
+void DeclStmt::FoldConstants()
+{
+	decl->FoldConstants();
+}
+
 llvm::Value* DeclStmt::Emit()
 {
 	return decl->Emit();
@@ -141,6 +351,17 @@ ConditionalStmt::ConditionalStmt(Expr *t, Stmt *b) {
     (body=b)->SetParent(this);
 }
 
+void ConditionalStmt::WalkChildren(NodeVisitor *visitor) {
+    test->Walk(visitor);
+    body->Walk(visitor);
+}
+
+void ConditionalStmt::FoldConstants()
+{
+	test = Expr::Fold(test);
+	body->FoldConstants();
+}
+
 
 ForStmt::ForStmt(Expr *i, Expr *t, Expr *s, Stmt *b): LoopStmt(t, b) { 
     Assert(i != NULL && t != NULL && b != NULL);
@@ -158,119 +379,327 @@ void ForStmt::PrintChildren(int indentLevel) {
     body->Print(indentLevel+1, "(body) ");
 }
 
-llvm::Value* ForStmt::Emit()
-{
+void ForStmt::WalkChildren(NodeVisitor *visitor) {
+    init->Walk(visitor);
+    test->Walk(visitor);
+    if ( step )
+      step->Walk(visitor);
+    body->Walk(visitor);
+}
 
-	inLoop = true;
+void ForStmt::FoldConstants()
+{
+	init->FoldConstants();
+	if(step != NULL)
+		step->FoldConstants();
 
-	//footer
-	llvm::BasicBlock *footerBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "footerBB", irgen->GetFunction(), !bbStack.empty() ? bbStack.back() : NULL);
-	bbStack.push_back(footerBB);
-	bbLoopExitStack.push_back(footerBB);
+	ConditionalStmt::FoldConstants();
+}
 
-	//step
-	llvm::BasicBlock *stepBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "stepBB", irgen->GetFunction(), footerBB);
-	bbStack.push_back(stepBB);
-	bbContinueStack.push_back(stepBB);
+llvm::Value* LoopStmt::EmitTest()
+{
+	llvm::Value *cond = test->Emit();
+	if(cond->getType()->isPointerTy())
+		cond = irgen->CreateLoad(cond);
 
-	//body
-	llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "bodyBB", irgen->GetFunction(), stepBB);
+	return cond;
+}
 
-	//header
-	llvm::BasicBlock *headerBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "headerBB", irgen->GetFunction(), bodyBB);
+/* Loops are emitted rotated and guarded, the shape the LLVM loop passes
+ * expect:
+ *
+ *	guard:      if(test) goto preheader else goto footer
+ *	preheader:  goto body
+ *	body:       ...                      continue goes to the latch
+ *	latch:      step; if(test) goto body else goto exit
+ *	exit:       goto footer              break goes here
+ *	footer:
+ *
+ * The latch holds the only back edge, and the exit block is reached from
+ * inside the loop only.  The test is emitted twice, but each evaluation
+ * still happens once per check.  Locals updated in the loop become phis
+ * in the body block, so a local counter is an induction variable.
+ */
+llvm::Value* LoopStmt::EmitRotated(Expr *step)
+{
+	bool outerLoop = inLoop;
+	inLoop = true;
 
+	llvm::LLVMContext &context = *(irgen->GetContext());
+	llvm::Function *func = irgen->GetFunction();
 
-	//branch to loop
-	init->Emit();
-	llvm::BranchInst::Create(headerBB,irgen->GetBasicBlock());
+	llvm::BasicBlock *footerBB = llvm::BasicBlock::Create(context, "footerBB", func, !bbStack.empty() ? bbStack.back() : NULL);
+	llvm::BasicBlock *exitBB = llvm::BasicBlock::Create(context, "exitBB", func, footerBB);
+	llvm::BasicBlock *latchBB = llvm::BasicBlock::Create(context, "latchBB", func, exitBB);
+	llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(context, "bodyBB", func, latchBB);
+	llvm::BasicBlock *preheaderBB = llvm::BasicBlock::Create(context, "preheaderBB", func, bodyBB);
+	bbStack.push_back(footerBB);
+	bbLoopExitStack.push_back(exitBB);
+	bbContinueStack.push_back(latchBB);
 
-	//populate headerBB
-	irgen->SetBasicBlock(headerBB);
-	llvm::Value *cond = test->Emit();
-	if(llvm::AllocaInst::classof(cond) || llvm::GlobalVariable::classof(cond) || llvm::GetElementPtrInst::classof(cond))
-		cond = new llvm::LoadInst(cond, "", irgen->GetBasicBlock());
-	llvm::BranchInst::Create(bodyBB, footerBB, cond, irgen->GetBasicBlock());
+	//guard
+	irgen->GetBuilder()->CreateCondBr(EmitTest(), preheaderBB, footerBB);
 
+	irgen->SetBasicBlock(preheaderBB);
+	irgen->SealBlock(preheaderBB);
+	irgen->GetBuilder()->CreateBr(bodyBB);
 
-	//populate bodyBB
+	//body, sealed once the back edge is in
+	bbStack.push_back(latchBB);
 	irgen->SetBasicBlock(bodyBB);
-	this->body->Emit();
+	body->Emit();
 
 	//no return stmt in body
 	if(irgen->GetBasicBlock()->getTerminator() == NULL)
-		llvm::BranchInst::Create(stepBB, irgen->GetBasicBlock());
+		irgen->GetBuilder()->CreateBr(latchBB);
 	else
 		retStmtIncluded = false;
+	bbStack.pop_back();
 
+	//latch, body and continues are its only predecessors
+	irgen->SetBasicBlock(latchBB);
+	irgen->SealBlock(latchBB);
+	if(step != NULL)
+		step->Emit();
+	llvm::BranchInst *backEdge = irgen->GetBuilder()->CreateCondBr(EmitTest(), bodyBB, exitBB);
+	irgen->SetLoopHints(backEdge, unrollCount, vectorizeWidth);
+	irgen->SealBlock(bodyBB);
+
+	//exit, reached from the latch and from breaks
+	irgen->SetBasicBlock(exitBB);
+	irgen->SealBlock(exitBB);
+	irgen->GetBuilder()->CreateBr(footerBB);
 
-	//populate stepBB
-	irgen->SetBasicBlock(bbStack.back());
-	bbStack.pop_back();
-	step->Emit();
-	llvm::BranchInst::Create(headerBB, irgen->GetBasicBlock());
-	
 	//end of loop
 	irgen->SetBasicBlock(footerBB);
+	irgen->SealBlock(footerBB);
 
 	bbStack.pop_back();
 	bbContinueStack.pop_back();
 	bbLoopExitStack.pop_back();
-	inLoop = false;
+	inLoop = outerLoop;
 	return llvm::UndefValue::get(irgen->GetVoidType());
 }
 
-void WhileStmt::PrintChildren(int indentLevel) {
-    test->Print(indentLevel+1, "(test) ");
-    body->Print(indentLevel+1, "(body) ");
+//true if expr is a read of the variable called name
+static bool IsVariable(Expr *expr, const char *name)
+{
+	VarExpr *var = dynamic_cast<VarExpr *>(expr);
+	return var != NULL && strcmp(var->GetIdentifier()->GetName(), name) == 0;
 }
 
-llvm::Value* WhileStmt::Emit()
+//looks for assignments, ++ and -- of one variable (or a declaration
+//hiding it, which is treated the same) and for calls
+class WriteFinder : public NodeVisitor
+{
+  public:
+    const char *name;
+    bool found;
+    bool calls;
+
+    WriteFinder(const char *n) : name(n), found(false), calls(false) {}
+    void Visit(Node *node);
+};
+
+void WriteFinder::Visit(Node *node)
+{
+	AssignExpr *assign = dynamic_cast<AssignExpr *>(node);
+	PostfixExpr *postfix = dynamic_cast<PostfixExpr *>(node);
+	ArithmeticExpr *arith = dynamic_cast<ArithmeticExpr *>(node);
+	VarDecl *decl = dynamic_cast<VarDecl *>(node);
+
+	if(assign != NULL && IsVariable(assign->GetLeft(), name))
+		found = true;
+	else if(postfix != NULL && IsVariable(postfix->GetLeft(), name))
+		found = true;
+	else if(arith != NULL && (arith->GetOp()->IsOp("++") || arith->GetOp()->IsOp("--")) && IsVariable(arith->GetRight(), name))
+		found = true;
+	else if(decl != NULL && strcmp(decl->GetIdentifier()->GetName(), name) == 0)
+		found = true;
+
+	if(dynamic_cast<Call *>(node) != NULL)
+		calls = true;
+}
+
+//value of "i <op> bound" for an int induction variable
+static bool CompareInt(Operator *op, long long i, long long bound)
+{
+	if(op->IsOp("<"))
+		return i < bound;
+	if(op->IsOp("<="))
+		return i <= bound;
+	if(op->IsOp(">"))
+		return i > bound;
+	if(op->IsOp(">="))
+		return i >= bound;
+
+	return i != bound;
+}
+
+//a counted loop has the form "for(i = c0; i <op> c1; <step>)" with an int
+//counter i (other counter types keep the loop), integer constants c0 and c1 (literals or const variables, see FoldConstants), a
+//step of i++, i--, ++i, --i, i += c or i -= c, and a body that never writes
+//i.  Fills in the value i has in every iteration and after the loop.
+bool ForStmt::GetUnrollValues(VarExpr *&var, std::vector<int> &values, int &exitValue)
 {
+	//#pragma unroll(N) fully unrolls up to N iterations, nounroll never, and
+	//a loop marked for the vectorizer is left to it
+	int threshold = GetIntOption("unroll-threshold", 16);
+	if(unrollCount >= 0)
+		threshold = unrollCount;
+	else if(vectorizeWidth > 1)
+		threshold = 0;
+	if(threshold <= 0 || step == NULL)
+		return false;
+
+	//init: i = c0
+	AssignExpr *start = dynamic_cast<AssignExpr *>(init);
+	if(start == NULL || !start->GetOp()->IsOp("="))
+		return false;
+
+	var = dynamic_cast<VarExpr *>(start->GetLeft());
+	llvm::ConstantInt *first = llvm::dyn_cast_or_null<llvm::ConstantInt>(start->GetRight()->Evaluate());
+	if(var == NULL || first == NULL)
+		return false;
+	if(var->GetValueType() != irgen->GetIntType() || var->IsUnsigned())
+		return false;
+
+	const char *name = var->GetIdentifier()->GetName();
+
+	//test: i <op> c1
+	CompoundExpr *cmp = dynamic_cast<RelationalExpr *>(test);
+	EqualityExpr *notEqual = dynamic_cast<EqualityExpr *>(test);
+	if(notEqual != NULL && notEqual->GetOp()->IsOp("!="))
+		cmp = notEqual;
+	if(cmp == NULL || !IsVariable(cmp->GetLeft(), name))
+		return false;
+
+	llvm::ConstantInt *bound = llvm::dyn_cast_or_null<llvm::ConstantInt>(cmp->GetRight()->Evaluate());
+	if(bound == NULL)
+		return false;
+
+	//step: distance between two iterations
+	long long delta = 0;
+	CompoundExpr *update = dynamic_cast<CompoundExpr *>(step);
+	if(update == NULL)
+		return false;
+
+	Operator *op = update->GetOp();
+	if(dynamic_cast<PostfixExpr *>(update) != NULL && IsVariable(update->GetLeft(), name))
+		delta = op->IsOp("++") ? 1 : -1;
+	else if(dynamic_cast<ArithmeticExpr *>(update) != NULL && update->GetLeft() == NULL &&
+	        (op->IsOp("++") || op->IsOp("--")) && IsVariable(update->GetRight(), name))
+		delta = op->IsOp("++") ? 1 : -1;
+	else if(dynamic_cast<AssignExpr *>(update) != NULL && (op->IsOp("+=") || op->IsOp("-=")) && IsVariable(update->GetLeft(), name))
+	{
+		llvm::ConstantInt *amount = llvm::dyn_cast_or_null<llvm::ConstantInt>(update->GetRight()->Evaluate());
+		if(amount == NULL)
+			return false;
+
+		delta = op->IsOp("+=") ? amount->getSExtValue() : -amount->getSExtValue();
+	}
+	else
+		return false;
+
+	//a global counter may also be written by a called function
+	WriteFinder writes(name);
+	body->Walk(&writes);
+	Symbol *sym = symbolTable->find(name);
+	bool global = sym != NULL && llvm::isa<llvm::GlobalVariable>(sym->value);
+	if(writes.found || (global && writes.calls))
+		return false;
+
+	//run the loop, giving up past the threshold
+	long long i = first->getSExtValue();
+	values.clear();
+	while(CompareInt(cmp->GetOp(), i, bound->getSExtValue()))
+	{
+		if((int)values.size() >= threshold)
+			return false;
+
+		values.push_back(i);
+		i += delta;
+	}
+
+	exitValue = i;
+	return true;
+}
+
+//one copy of the body per iteration, each one preceded by a store of the
+//constant induction value; continue jumps to the next copy
+llvm::Value* ForStmt::EmitUnrolled(VarExpr *var, const std::vector<int> &values, int exitValue)
+{
+	bool outerLoop = inLoop;
 	inLoop = true;
 
-	//footer bb
+	llvm::Value *counter = var->Emit();
+	llvm::Type *intType = irgen->GetIntType();
+
+	//footer
 	llvm::BasicBlock *footerBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "footerBB", irgen->GetFunction(), !bbStack.empty() ? bbStack.back() : NULL);
 	bbStack.push_back(footerBB);
 	bbLoopExitStack.push_back(footerBB);
 
-	//body bb
-	llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "bodyBB", irgen->GetFunction(), footerBB);
+	for(unsigned k = 0; k < values.size(); k++)
+	{
+		llvm::BasicBlock *nextBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "unrollBB", irgen->GetFunction(), footerBB);
+		bbContinueStack.push_back(nextBB);
 
-	//test bb
-	llvm::BasicBlock *testBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "headerBB", irgen->GetFunction(), bodyBB);
-	bbContinueStack.push_back(testBB);
+		irgen->CreateStore(llvm::ConstantInt::get(intType, values[k]), counter);
 
-	//branch to while testBB
-	llvm::BranchInst::Create(testBB, irgen->GetBasicBlock());
+		//each copy declares its own locals, even when the body is not a block
+		symbolTable->push();
+		this->body->Emit();
+		symbolTable->pop();
 
-	//Emit test
-	irgen->SetBasicBlock(testBB);
-	llvm::Value *cond = test->Emit();
-	if(llvm::AllocaInst::classof(cond) || llvm::GlobalVariable::classof(cond) || llvm::GetElementPtrInst::classof(cond))
-		cond = new llvm::LoadInst(cond, "", irgen->GetBasicBlock());
-	llvm::BranchInst::Create(bodyBB, footerBB, cond, irgen->GetBasicBlock());
+		//no return stmt in body
+		if(irgen->GetBasicBlock()->getTerminator() == NULL)
+			irgen->GetBuilder()->CreateBr(nextBB);
+		else
+			retStmtIncluded = false;
 
-	//Emit body
-	irgen->SetBasicBlock(bodyBB);
-	body->Emit();
+		//body and continues are its only predecessors
+		bbContinueStack.pop_back();
+		irgen->SetBasicBlock(nextBB);
+		irgen->SealBlock(nextBB);
+	}
 
-	//no return stmt in body
-	if(irgen->GetBasicBlock()->getTerminator() == NULL)
-		llvm::BranchInst::Create(testBB, irgen->GetBasicBlock());
-	else
-		retStmtIncluded = false;
+	//value the variable has once the test fails
+	irgen->CreateStore(llvm::ConstantInt::get(intType, exitValue), counter);
+	irgen->GetBuilder()->CreateBr(footerBB);
 
-	//set footer bb
-	irgen->SetBasicBlock(bbStack.back());
-	bbStack.pop_back();
-	
+	//end of loop, breaks jump here
+	irgen->SetBasicBlock(footerBB);
+	irgen->SealBlock(footerBB);
 
-	inLoop = false;
-	bbLoopExitStack.pop_back();
-	bbContinueStack.pop_back();
+	PrintStat("for loop at line %d unrolled %d times", init->GetLocation() ? init->GetLocation()->first_line : 0, (int)values.size());
 
+	bbStack.pop_back();
+	bbLoopExitStack.pop_back();
+	inLoop = outerLoop;
 	return llvm::UndefValue::get(irgen->GetVoidType());
-	
+}
+
+llvm::Value* ForStmt::Emit()
+{
+	VarExpr *var;
+	std::vector<int> values;
+	int exitValue;
+	if(GetUnrollValues(var, values, exitValue))
+		return EmitUnrolled(var, values, exitValue);
+
+	init->Emit();
+	return EmitRotated(step);
+}
+
+void WhileStmt::PrintChildren(int indentLevel) {
+    test->Print(indentLevel+1, "(test) ");
+    body->Print(indentLevel+1, "(body) ");
+}
+
+llvm::Value* WhileStmt::Emit()
+{
+	return EmitRotated(NULL);
 }
 
 IfStmt::IfStmt(Expr *t, Stmt *tb, Stmt *eb): ConditionalStmt(t, tb) { 
@@ -285,11 +714,23 @@ void IfStmt::PrintChildren(int indentLevel) {
     if (elseBody) elseBody->Print(indentLevel+1, "(else) ");
 }
 
+void IfStmt::WalkChildren(NodeVisitor *visitor) {
+    ConditionalStmt::WalkChildren(visitor);
+    if (elseBody) elseBody->Walk(visitor);
+}
+
+void IfStmt::FoldConstants()
+{
+	ConditionalStmt::FoldConstants();
+	if(elseBody != NULL)
+		elseBody->FoldConstants();
+}
+
 llvm::Value* IfStmt::Emit()
 {
 	llvm::Value *testCond = test->Emit();
-	if(llvm::AllocaInst::classof(testCond) || llvm::GlobalVariable::classof(testCond) || llvm::GetElementPtrInst::classof(testCond))
-		testCond = new llvm::LoadInst(testCond, "", irgen->GetBasicBlock());
+	if(testCond->getType()->isPointerTy())
+		testCond = irgen->CreateLoad(testCond);
 
 	llvm::BasicBlock *footerBB = llvm::BasicBlock::Create(*(irgen->GetContext()), "footerBB", irgen->GetFunction());
 	bbStack.push_back(footerBB);
@@ -308,13 +749,14 @@ llvm::Value* IfStmt::Emit()
 
 	//branch if
 	if(elseBody != NULL)
-		llvm::BranchInst::Create(thenBB, elseBB, testCond, irgen->GetBasicBlock());
+		irgen->GetBuilder()->CreateCondBr(testCond, thenBB, elseBB);
 	else
-		llvm::BranchInst::Create(thenBB, footerBB, testCond, irgen->GetBasicBlock());
+		irgen->GetBuilder()->CreateCondBr(testCond, thenBB, footerBB);
 
 	//populate thenBB
 
 	irgen->SetBasicBlock(thenBB);
+	irgen->SealBlock(thenBB);
 	body->Emit();
 	if(elseBB != NULL)
 		elseBB->moveAfter(thenBB);
@@ -324,7 +766,7 @@ llvm::Value* IfStmt::Emit()
 	if(irgen->GetBasicBlock()->getTerminator() == NULL)
 	{
 		//cerr << "NO TERMINATOR\n";
-		llvm::BranchInst::Create(footerBB, irgen->GetBasicBlock());
+		irgen->GetBuilder()->CreateBr(footerBB);
 	}
 	retStmtIncluded = false;
 
@@ -334,17 +776,20 @@ llvm::Value* IfStmt::Emit()
 	if(elseBody != NULL)
 	{
 		irgen->SetBasicBlock(elseBB);
+		irgen->SealBlock(elseBB);
 		//bbStack.pop_back();
 		elseBody->Emit();
+
+		//else body may have ended in a nested block
+		if(irgen->GetBasicBlock()->getTerminator() == NULL)
+			irgen->GetBuilder()->CreateBr(footerBB);
 	}
 
 	footerBB->moveAfter(elseBB ? elseBB : thenBB);
-	
-	if(elseBody != NULL && elseBB->getTerminator() == NULL)
-		llvm::BranchInst::Create(footerBB, elseBB);
 
 	//set footerBB
 	irgen->SetBasicBlock(footerBB);
+	irgen->SealBlock(footerBB);
 	if(!bbStack.empty())
 		bbStack.pop_back();
 
@@ -356,14 +801,14 @@ llvm::Value* BreakStmt::Emit()
 {
 	retStmtIncluded =  true;
 
-	return llvm::BranchInst::Create(inLoop ? bbLoopExitStack.back() : bbStack.back(), irgen->GetBasicBlock());
+	return irgen->GetBuilder()->CreateBr(inLoop ? bbLoopExitStack.back() : bbStack.back());
 }
 
 llvm::Value* ContinueStmt::Emit()
 {
 	//cerr << "continue called\n";
 	
-	return llvm::BranchInst::Create(bbContinueStack.back(), irgen->GetBasicBlock());
+	return irgen->GetBuilder()->CreateBr(bbContinueStack.back());
 }
 
 ReturnStmt::ReturnStmt(yyltype loc, Expr *e) : Stmt(loc) { 
@@ -376,6 +821,17 @@ void ReturnStmt::PrintChildren(int indentLevel) {
       expr->Print(indentLevel+1);
 }
 
+void ReturnStmt::WalkChildren(NodeVisitor *visitor) {
+    if ( expr )
+      expr->Walk(visitor);
+}
+
+void ReturnStmt::FoldConstants()
+{
+	if(expr != NULL)
+		expr = Expr::Fold(expr);
+}
+
 llvm::Value* ReturnStmt::Emit()
 {
 	retStmtIncluded = true;
@@ -386,14 +842,14 @@ llvm::Value* ReturnStmt::Emit()
 		llvm::Value *value = expr->Emit();
 
 		//load variable
-		if(llvm::AllocaInst::classof(value) || llvm::GlobalVariable::classof(value) || llvm::GetElementPtrInst::classof(value))
-			value = new llvm::LoadInst(value, "ld1", irgen->GetBasicBlock());
+		if(value->getType()->isPointerTy())
+			value = irgen->CreateLoad(value);
 
-		llvm::ReturnInst *ret = llvm::ReturnInst::Create(*(irgen->GetContext()), value, irgen->GetBasicBlock());
+		llvm::Value *ret = irgen->GetBuilder()->CreateRet(value);
 		return ret;
 	}
 	else
-		return llvm::ReturnInst::Create(*(irgen->GetContext()), irgen->GetBasicBlock());
+		return irgen->GetBuilder()->CreateRetVoid();
 }
 
 SwitchLabel::SwitchLabel(Expr *l, Stmt *s) {
@@ -413,6 +869,18 @@ void SwitchLabel::PrintChildren(int indentLevel) {
     if (stmt)  stmt->Print(indentLevel+1);
 }
 
+void SwitchLabel::WalkChildren(NodeVisitor *visitor) {
+    if (label) label->Walk(visitor);
+    if (stmt)  stmt->Walk(visitor);
+}
+
+void SwitchLabel::FoldConstants()
+{
+	if(label != NULL)
+		label = Expr::Fold(label);
+	stmt->FoldConstants();
+}
+
 llvm::Value* Case::Emit()
 {
 	stmt->Emit();
@@ -439,6 +907,21 @@ void SwitchStmt::PrintChildren(int indentLevel) {
     if (def) def->Print(indentLevel+1);
 }
 
+void SwitchStmt::WalkChildren(NodeVisitor *visitor) {
+    if (expr) expr->Walk(visitor);
+    if (cases) cases->WalkAll(visitor);
+    if (def) def->Walk(visitor);
+}
+
+void SwitchStmt::FoldConstants()
+{
+	expr = Expr::Fold(expr);
+	for(int i = 0; i < cases->NumElements(); i++)
+		cases->Nth(i)->FoldConstants();
+	if(def != NULL)
+		def->FoldConstants();
+}
+
 llvm::Value* SwitchStmt::Emit()
 {
 	llvm::BasicBlock *initBB = irgen->GetBasicBlock();
@@ -475,11 +958,11 @@ llvm::Value* SwitchStmt::Emit()
 	llvm::Value *switchValue = expr->Emit();
 	
 	//load swithValue if necessary
-	if(llvm::UnaryInstruction::classof(switchValue) || llvm::GlobalVariable::classof(switchValue) || llvm::GetElementPtrInst::classof(switchValue))
-			switchValue = new llvm::LoadInst(switchValue, "ld1", irgen->GetBasicBlock());
+	if(switchValue->getType()->isPointerTy())
+			switchValue = irgen->CreateLoad(switchValue);
 
 	//create swtich inst
-	llvm::SwitchInst *switchInst = llvm::SwitchInst::Create(switchValue, defaultBB ? defaultBB : exitBB, bbs.size(), irgen->GetBasicBlock());
+	llvm::SwitchInst *switchInst = irgen->GetBuilder()->CreateSwitch(switchValue, defaultBB ? defaultBB : exitBB, bbs.size());
 
 	//emit case stmts
 	int i;
@@ -491,7 +974,7 @@ llvm::Value* SwitchStmt::Emit()
 		//no terminator in bb
 		if(!irgen->GetBasicBlock()->getTerminator())
 		{
-			llvm::BranchInst::Create(bbs[i+1], irgen->GetBasicBlock());
+			irgen->GetBuilder()->CreateBr(bbs[i+1]);
 		}
 
 		//add case to switch
@@ -505,10 +988,15 @@ llvm::Value* SwitchStmt::Emit()
 		cases->Nth(i)->Emit();
 
 		if(!irgen->GetBasicBlock()->getTerminator())
-			llvm::BranchInst::Create(exitBB, irgen->GetBasicBlock());
+			irgen->GetBuilder()->CreateBr(exitBB);
 	}
 
 
+	//case edges are only added to the switch after each case is emitted
+	for(i = 0; i < bbs.size(); i++)
+		irgen->SealBlock(bbs[i]);
+	irgen->SealBlock(exitBB);
+
 	irgen->SetBasicBlock(bbStack.back());
 	bbStack.pop_back();
 	
@@ -15,11 +15,13 @@
 
 #include "list.h"
 #include "ast.h"
+#include <set>
 
 class Decl;
 class VarDecl;
 class Expr;
 class IntConstant;
+class VarExpr;
   
 void yyerror(const char *msg);
 
@@ -32,7 +34,13 @@ class Program : public Node
      Program(List<Decl*> *declList);
      const char *GetPrintNameForNode() { return "Program"; }
      void PrintChildren(int indentLevel);
+     void WalkChildren(NodeVisitor *visitor);
+     void FoldConstants();
      virtual llvm::Value* Emit();
+
+     // top-level declarations reachable from the --entry functions over
+     // calls and variable references, the entry points included
+     void FindReachable(std::set<Decl*> &reachable);
 };
 
 class Stmt : public Node
@@ -54,8 +62,15 @@ class StmtBlock : public Stmt
     StmtBlock(List<VarDecl*> *variableDeclarations, List<Stmt*> *statements);
     const char *GetPrintNameForNode() { return "StmtBlock"; }
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
 
 	virtual llvm::Value* Emit();
+
+  protected:
+	//v.x = a; v.y = b; ... starting at stmts[first] as one load and one
+	//store of v, returns the number of statements emitted (0 if none)
+	int EmitCombinedStores(int first);
 };
 
 class DeclStmt: public Stmt 
@@ -67,6 +82,8 @@ class DeclStmt: public Stmt
     DeclStmt(Decl *d);
     const char *GetPrintNameForNode() { return "DeclStmt"; }
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
 
 	llvm::Value* Emit();
 
@@ -81,15 +98,28 @@ class ConditionalStmt : public Stmt
   public:
     ConditionalStmt() : Stmt(), test(NULL), body(NULL) {}
     ConditionalStmt(Expr *testExpr, Stmt *body);
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
 
 	virtual llvm::Value* Emit() {return llvm::UndefValue::get(irgen->GetVoidType());}
 };
 
 class LoopStmt : public ConditionalStmt 
 {
+  protected:
+    int unrollCount;     //#pragma unroll(N), 0 for nounroll, -1 if not given
+    int vectorizeWidth;  //#pragma vectorize(W), -1 if not given
+
+    //rotated loop with guard, preheader, latch and exit blocks, the step
+    //(NULL for while loops) runs in the latch
+    llvm::Value* EmitRotated(Expr *step);
+    llvm::Value* EmitTest();
+
   public:
     LoopStmt(Expr *testExpr, Stmt *body)
-            : ConditionalStmt(testExpr, body) {}
+            : ConditionalStmt(testExpr, body), unrollCount(-1), vectorizeWidth(-1) {}
+    void SetUnrollCount(int count) { unrollCount = count; }
+    void SetVectorizeWidth(int width) { vectorizeWidth = width; }
 
 	virtual llvm::Value* Emit() {return llvm::UndefValue::get(irgen->GetVoidType());}
 
@@ -99,11 +129,17 @@ class ForStmt : public LoopStmt
 {
   protected:
     Expr *init, *step;
+
+    //counted loops under -unroll-threshold iterations are fully unrolled
+    bool GetUnrollValues(VarExpr *&var, std::vector<int> &values, int &exitValue);
+    llvm::Value* EmitUnrolled(VarExpr *var, const std::vector<int> &values, int exitValue);
   
   public:
     ForStmt(Expr *init, Expr *test, Expr *step, Stmt *body);
     const char *GetPrintNameForNode() { return "ForStmt"; }
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
 
 	llvm::Value* Emit();
 
@@ -130,6 +166,8 @@ class IfStmt : public ConditionalStmt
     IfStmt(Expr *test, Stmt *thenBody, Stmt *elseBody);
     const char *GetPrintNameForNode() { return "IfStmt"; }
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
 
 	llvm::Value* Emit();
 
@@ -170,6 +208,8 @@ class ReturnStmt : public Stmt
     ReturnStmt(yyltype loc, Expr *expr = NULL);
     const char *GetPrintNameForNode() { return "ReturnStmt"; }
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
 
 	llvm::Value* Emit();
 };
@@ -185,6 +225,8 @@ class SwitchLabel : public Stmt
     SwitchLabel(Expr *label, Stmt *stmt);
     SwitchLabel(Stmt *stmt);
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
 
 	virtual llvm::Value* Emit() { return llvm::UndefValue::get(irgen->GetVoidType());}
 
@@ -221,6 +263,8 @@ class SwitchStmt : public Stmt
     SwitchStmt(Expr *expr, List<Stmt*> *cases, Default *def);
     virtual const char *GetPrintNameForNode() { return "SwitchStmt"; }
     void PrintChildren(int indentLevel);
+    void WalkChildren(NodeVisitor *visitor);
+    void FoldConstants();
 
 	llvm::Value* Emit();
 
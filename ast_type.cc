@@ -41,6 +41,8 @@ TypeQualifier *TypeQualifier::inTypeQualifier  = new TypeQualifier("in");
 TypeQualifier *TypeQualifier::outTypeQualifier = new TypeQualifier("out");
 TypeQualifier *TypeQualifier::constTypeQualifier = new TypeQualifier("const");
 TypeQualifier *TypeQualifier::uniformTypeQualifier = new TypeQualifier("uniform");
+TypeQualifier *TypeQualifier::volatileTypeQualifier = new TypeQualifier("volatile");
+TypeQualifier *TypeQualifier::preciseTypeQualifier = new TypeQualifier("precise");
 
 Type::Type(const char *n) {
     Assert(n);
@@ -76,13 +78,20 @@ bool Type::IsMatrix() {
            this->IsEquivalentTo(Type::mat4Type);
 }
 
+bool Type::IsUnsigned() { 
+    return this->IsEquivalentTo(Type::uintType) || 
+           this->IsEquivalentTo(Type::uvec2Type) || 
+           this->IsEquivalentTo(Type::uvec3Type) ||  
+           this->IsEquivalentTo(Type::uvec4Type);
+}
+
 bool Type::IsError() { 
     return this->IsEquivalentTo(Type::errorType);
 }
 
 llvm::Type* Type::typeToLlvmType()
 {
-	llvm::Type *llvmType;
+	llvm::Type *llvmType = NULL;
 	if(this->IsEquivalentTo(Type::intType))
 	{
 		llvmType = irgen->GetIntType();
@@ -111,6 +120,50 @@ llvm::Type* Type::typeToLlvmType()
 	{		
 		llvmType = irgen->GetVec4Type();
 	}
+	else if(this->IsEquivalentTo(Type::uintType))
+	{
+		llvmType = irgen->GetIntType();
+	}
+	else if(this->IsEquivalentTo(Type::ivec2Type) || this->IsEquivalentTo(Type::uvec2Type))
+	{
+		llvmType = irgen->GetIntVecType(2);
+	}
+	else if(this->IsEquivalentTo(Type::ivec3Type) || this->IsEquivalentTo(Type::uvec3Type))
+	{
+		llvmType = irgen->GetIntVecType(3);
+	}
+	else if(this->IsEquivalentTo(Type::ivec4Type) || this->IsEquivalentTo(Type::uvec4Type))
+	{
+		llvmType = irgen->GetIntVecType(4);
+	}
+	else if(this->IsEquivalentTo(Type::bvec2Type))
+	{
+		llvmType = irgen->GetBoolVecType(2);
+	}
+	else if(this->IsEquivalentTo(Type::bvec3Type))
+	{
+		llvmType = irgen->GetBoolVecType(3);
+	}
+	else if(this->IsEquivalentTo(Type::bvec4Type))
+	{
+		llvmType = irgen->GetBoolVecType(4);
+	}
+	else if(this->IsEquivalentTo(Type::mat2Type))
+	{
+		llvmType = irgen->GetMat2Type();
+	}
+	else if(this->IsEquivalentTo(Type::mat3Type))
+	{
+		llvmType = irgen->GetMat3Type();
+	}
+	else if(this->IsEquivalentTo(Type::mat4Type))
+	{
+		llvmType = irgen->GetMat4Type();
+	}
+	else if(ArrayType *arrayType = dynamic_cast<ArrayType *>(this))
+	{
+		llvmType = llvm::ArrayType::get(arrayType->GetElemType()->typeToLlvmType(), arrayType->GetElemCount());
+	}
 
 	return llvmType;
 }
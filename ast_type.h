@@ -26,7 +26,8 @@ class TypeQualifier : public Node
     char *typeQualifierName;
 
   public :
-    static TypeQualifier *inTypeQualifier, *outTypeQualifier, *constTypeQualifier, *uniformTypeQualifier;
+    static TypeQualifier *inTypeQualifier, *outTypeQualifier, *constTypeQualifier, *uniformTypeQualifier,
+                         *volatileTypeQualifier, *preciseTypeQualifier;
 
     TypeQualifier(yyltype loc) : Node(loc) {}
     TypeQualifier(const char *str);
@@ -62,6 +63,7 @@ class Type : public Node
     bool IsNumeric();
     bool IsVector();
     bool IsMatrix();
+    bool IsUnsigned();
     bool IsError();
 
 	llvm::Type* typeToLlvmType();
@@ -4,18 +4,28 @@
  */
 
 #include "irgen.h"
+#include "utility.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/IR/ValueHandle.h"
 #include <iostream>
+#include <string.h>
 
 
 IRGenerator::IRGenerator() :
     context(NULL),
     module(NULL),
     currentFunc(NULL),
-    currentBB(NULL)
+    currentBB(NULL),
+    builder(NULL),
+    contract(false),
+    reassociate(false)
 {
 }
 
 IRGenerator::~IRGenerator() {
+   delete builder;
 }
 
 llvm::Module *IRGenerator::GetOrCreateModule(const char *moduleID)
@@ -25,6 +35,7 @@ llvm::Module *IRGenerator::GetOrCreateModule(const char *moduleID)
      module  = new llvm::Module(moduleID, *context);
      module->setTargetTriple(TargetTriple);
      module->setDataLayout(TargetLayout);
+     builder = new llvm::IRBuilder<>(*context);
    }
    return module;
 }
@@ -33,12 +44,50 @@ void IRGenerator::SetFunction(llvm::Function *func) {
    currentFunc = func;
 }
 
+void IRGenerator::SetFloatSemantics(llvm::Function *func, bool precise)
+{
+	llvm::FastMathFlags flags;
+	contract = false;
+	reassociate = false;
+
+	if(!precise)
+	{
+		//this LLVM has no separate reassoc flag, reassociation comes with
+		//unsafe-algebra, which implies the other flags as well
+		bool fast = IsOptionOn("fast-math");
+		if(fast || IsOptionOn("reassoc"))
+			flags.setUnsafeAlgebra();
+		if(fast || IsOptionOn("arcp"))
+			flags.setAllowReciprocal();
+		if(fast || IsOptionOn("nnan"))
+			flags.setNoNaNs();
+		if(fast || IsOptionOn("ninf"))
+			flags.setNoInfs();
+
+		contract = fast || IsOptionOn("contract");
+		reassociate = flags.unsafeAlgebra();
+
+		//the backend reads these per function
+		if(flags.unsafeAlgebra())
+			func->addFnAttr("unsafe-fp-math", "true");
+		if(flags.noNaNs())
+			func->addFnAttr("no-nans-fp-math", "true");
+		if(flags.noInfs())
+			func->addFnAttr("no-infs-fp-math", "true");
+		if(fast || IsOptionOn("denormal-flush"))
+			func->addFnAttr("denormal-fp-math", "preserve-sign");
+	}
+
+	builder->SetFastMathFlags(flags);
+}
+
 llvm::Function *IRGenerator::GetFunction() const {
    return currentFunc;
 }
 
 void IRGenerator::SetBasicBlock(llvm::BasicBlock *bb) {
    currentBB = bb;
+   builder->SetInsertPoint(bb);
 }
 
 llvm::BasicBlock *IRGenerator::GetBasicBlock() const {
@@ -80,6 +129,34 @@ llvm::Type *IRGenerator::GetVec4Type() {
 	return ty;
 }
 
+//ivecN and uvecN share one type, signedness is in the instructions
+llvm::Type *IRGenerator::GetIntVecType(int width) {
+	llvm::Type *ty = llvm::VectorType::get(GetIntType(), width);
+	return ty;
+}
+
+llvm::Type *IRGenerator::GetBoolVecType(int width) {
+	llvm::Type *ty = llvm::VectorType::get(GetBoolType(), width);
+	return ty;
+}
+
+//column-major, one vector per column; vec3 columns are 16-byte aligned
+//by the data layout, so every column starts on its own 16-byte slot
+llvm::Type *IRGenerator::GetMat2Type() {
+	llvm::Type *ty = llvm::ArrayType::get(GetVec2Type(), 2);
+	return ty;
+}
+
+llvm::Type *IRGenerator::GetMat3Type() {
+	llvm::Type *ty = llvm::ArrayType::get(GetVec3Type(), 3);
+	return ty;
+}
+
+llvm::Type *IRGenerator::GetMat4Type() {
+	llvm::Type *ty = llvm::ArrayType::get(GetVec4Type(), 4);
+	return ty;
+}
+
 llvm::Type *IRGenerator::GetType(llvm::Value *value)
 {
 
@@ -113,15 +190,923 @@ llvm::Type *IRGenerator::GetType(llvm::Value *value)
 
 bool IRGenerator::IsFloatType(llvm::Value *value)
 {
+	//folded values are constants, so look at the type rather than the
+	//kind of instruction; addresses are float if they point to one
+	llvm::Type *type = value->getType();
+	if(llvm::PointerType *ptrType = llvm::dyn_cast<llvm::PointerType>(type))
+		type = ptrType->getElementType();
+
+	return type->isFloatTy();
+}
+
+llvm::StoreInst *IRGenerator::CreateStore(llvm::Value *value, llvm::Value *ptr)
+{
+	if(IsSSAVariable(ptr))
+	{
+		WriteVariable(ptr, currentBB, value);
+		return NULL;
+	}
+
+	bool isVolatile = IsOptionOn("volatile-stores") || IsVolatile(ptr);
+	return builder->CreateStore(value, ptr, isVolatile);
+}
+
+void IRGenerator::MarkVolatile(llvm::Value *var)
+{
+	volatileVars.insert(var);
+}
+
+bool IRGenerator::IsVolatile(llvm::Value *ptr) const
+{
+	//array element, look at the array variable
+	if(llvm::GEPOperator *gep = llvm::dyn_cast<llvm::GEPOperator>(ptr))
+		ptr = gep->getPointerOperand();
+
+	return volatileVars.count(ptr) != 0;
+}
+
+llvm::Value *IRGenerator::CreateLocal(llvm::Type *type, const char *name, bool isVolatile)
+{
+	//ssa variables are keyed by an alloca that is never inserted
+	if(!isVolatile && !IsOptionOn("no-ssa") && !llvm::ArrayType::classof(type))
+	{
+		llvm::AllocaInst *var = new llvm::AllocaInst(type, name);
+		ssaVars.insert(var);
+		return var;
+	}
+
+	//stack slot at the top of the entry block
+	llvm::BasicBlock *entryBB = &currentFunc->getEntryBlock();
+	llvm::AllocaInst *var;
+	if(entryBB->getTerminator() != NULL)
+		var = new llvm::AllocaInst(type, name, entryBB->getTerminator());
+	else
+		var = new llvm::AllocaInst(type, name, entryBB);
+
+	if(isVolatile)
+		MarkVolatile(var);
+
+	return var;
+}
+
+llvm::Value *IRGenerator::CreateLoad(llvm::Value *ptr)
+{
+	if(IsSSAVariable(ptr))
+		return ReadVariable(ptr, currentBB);
+
+	return builder->CreateLoad(ptr, IsVolatile(ptr));
+}
+
+bool IRGenerator::IsSSAVariable(llvm::Value *var) const
+{
+	return ssaVars.count(var) != 0;
+}
+
+void IRGenerator::WriteVariable(llvm::Value *var, llvm::BasicBlock *bb, llvm::Value *value)
+{
+	currentDef[var][bb] = value;
+}
+
+llvm::Value *IRGenerator::ReadVariable(llvm::Value *var, llvm::BasicBlock *bb)
+{
+	DefMap &defs = currentDef[var];
+	DefMap::iterator def = defs.find(bb);
+	if(def != defs.end())
+		return def->second;
+
+	return ReadVariableRecursive(var, bb);
+}
+
+//phi at the top of bb, operands are added once bb is sealed
+static llvm::PHINode *CreatePhi(llvm::Value *var, llvm::BasicBlock *bb)
+{
+	llvm::Type *type = llvm::cast<llvm::AllocaInst>(var)->getAllocatedType();
+	if(bb->empty())
+		return llvm::PHINode::Create(type, 0, var->getName(), bb);
+
+	return llvm::PHINode::Create(type, 0, var->getName(), &bb->front());
+}
+
+llvm::Value *IRGenerator::ReadVariableRecursive(llvm::Value *var, llvm::BasicBlock *bb)
+{
+	llvm::Value *value;
+
+	if(sealedBlocks.count(bb) == 0)
+	{
+		//more predecessors may still come
+		llvm::PHINode *phi = CreatePhi(var, bb);
+		incompletePhis[bb][var] = phi;
+		value = phi;
+	}
+	else if(bb->getSinglePredecessor() != NULL)
+	{
+		value = ReadVariable(var, bb->getSinglePredecessor());
+	}
+	else if(llvm::pred_begin(bb) == llvm::pred_end(bb))
+	{
+		//read before any write
+		value = llvm::UndefValue::get(llvm::cast<llvm::AllocaInst>(var)->getAllocatedType());
+	}
+	else
+	{
+		//break cycles with an operandless phi first
+		llvm::PHINode *phi = CreatePhi(var, bb);
+		WriteVariable(var, bb, phi);
+		value = AddPhiOperands(var, phi);
+	}
+
+	WriteVariable(var, bb, value);
+	return value;
+}
+
+llvm::Value *IRGenerator::AddPhiOperands(llvm::Value *var, llvm::PHINode *phi)
+{
+	llvm::BasicBlock *bb = phi->getParent();
+	for(llvm::pred_iterator pred = llvm::pred_begin(bb); pred != llvm::pred_end(bb); pred++)
+		phi->addIncoming(ReadVariable(var, *pred), *pred);
+
+	return TryRemoveTrivialPhi(phi);
+}
+
+llvm::Value *IRGenerator::TryRemoveTrivialPhi(llvm::PHINode *phi)
+{
+	llvm::Value *same = NULL;
+	for(unsigned i = 0; i < phi->getNumIncomingValues(); i++)
+	{
+		llvm::Value *op = phi->getIncomingValue(i);
+		if(op == same || op == phi)
+			continue;
+
+		//merges at least two values
+		if(same != NULL)
+			return phi;
+
+		same = op;
+	}
+
+	//unreachable or only reads itself
+	if(same == NULL)
+		same = llvm::UndefValue::get(phi->getType());
+
+	//phis using this one may become trivial too
+	std::vector<llvm::WeakVH> users;
+	for(llvm::Value::user_iterator u = phi->user_begin(); u != phi->user_end(); u++)
+	{
+		if(*u != phi && llvm::PHINode::classof(*u))
+			users.push_back(llvm::WeakVH(*u));
+	}
+
+	phi->replaceAllUsesWith(same);
+	for(std::map<llvm::Value *, DefMap>::iterator var = currentDef.begin(); var != currentDef.end(); var++)
+	{
+		for(DefMap::iterator def = var->second.begin(); def != var->second.end(); def++)
+		{
+			if(def->second == phi)
+				def->second = same;
+		}
+	}
+	phi->eraseFromParent();
+
+	for(unsigned i = 0; i < users.size(); i++)
+	{
+		if(llvm::PHINode *user = llvm::dyn_cast_or_null<llvm::PHINode>(static_cast<llvm::Value *>(users[i])))
+			TryRemoveTrivialPhi(user);
+	}
+
+	return same;
+}
+
+void IRGenerator::SealBlock(llvm::BasicBlock *bb)
+{
+	if(sealedBlocks.count(bb) != 0)
+		return;
+
+	std::map<llvm::Value *, llvm::PHINode *> &phis = incompletePhis[bb];
+	for(std::map<llvm::Value *, llvm::PHINode *>::iterator phi = phis.begin(); phi != phis.end(); phi++)
+		AddPhiOperands(phi->first, phi->second);
+
+	incompletePhis.erase(bb);
+	sealedBlocks.insert(bb);
+}
+
+void IRGenerator::FinishFunction()
+{
+	for(llvm::Function::iterator bb = currentFunc->begin(); bb != currentFunc->end(); bb++)
+		SealBlock(&*bb);
+
+	//the placeholder allocas were never part of the function, nothing
+	//may address them
+	for(std::set<llvm::Value *>::iterator var = ssaVars.begin(); var != ssaVars.end(); var++)
+	{
+		Assert((*var)->use_empty());
+		delete llvm::cast<llvm::AllocaInst>(*var);
+	}
+
+	ssaVars.clear();
+	currentDef.clear();
+	incompletePhis.clear();
+	sealedBlocks.clear();
+}
+
+/* Arithmetic lowering table
+ * -------------------------
+ * One entry per operator with the opcode used for signed and unsigned
+ * integer and for float operands.  Vectors use the same opcodes, applied
+ * lane-wise.  The bitwise operators have no float form (BinaryOpsEnd).
+ */
+struct ArithmeticOp {
+  const char *op;
+  llvm::Instruction::BinaryOps intOp;
+  llvm::Instruction::BinaryOps unsignedOp;
+  llvm::Instruction::BinaryOps floatOp;
+};
+
+static const ArithmeticOp arithmeticOps[] = {
+  { "+",  llvm::Instruction::Add,  llvm::Instruction::Add,  llvm::Instruction::FAdd },
+  { "-",  llvm::Instruction::Sub,  llvm::Instruction::Sub,  llvm::Instruction::FSub },
+  { "*",  llvm::Instruction::Mul,  llvm::Instruction::Mul,  llvm::Instruction::FMul },
+  { "/",  llvm::Instruction::SDiv, llvm::Instruction::UDiv, llvm::Instruction::FDiv },
+  { "%",  llvm::Instruction::SRem, llvm::Instruction::URem, llvm::Instruction::FRem },
+  { "<<", llvm::Instruction::Shl,  llvm::Instruction::Shl,  llvm::Instruction::BinaryOpsEnd },
+  { ">>", llvm::Instruction::AShr, llvm::Instruction::LShr, llvm::Instruction::BinaryOpsEnd },
+  { "&",  llvm::Instruction::And,  llvm::Instruction::And,  llvm::Instruction::BinaryOpsEnd },
+  { "|",  llvm::Instruction::Or,   llvm::Instruction::Or,   llvm::Instruction::BinaryOpsEnd },
+  { "^",  llvm::Instruction::Xor,  llvm::Instruction::Xor,  llvm::Instruction::BinaryOpsEnd },
+  { NULL, llvm::Instruction::Add,  llvm::Instruction::Add,  llvm::Instruction::FAdd }
+};
+
+llvm::Value *IRGenerator::CreateArithmetic(const char *op, llvm::Value *lhs, llvm::Value *rhs, bool isUnsigned)
+{
+	if(lhs->getType()->isArrayTy() || rhs->getType()->isArrayTy())
+		return CreateMatrixArithmetic(op, lhs, rhs);
+
+	const ArithmeticOp *entry = arithmeticOps;
+	while(entry->op != NULL && strcmp(entry->op, op) != 0)
+		entry++;
+	Assert(entry->op != NULL);
+
+	//vector and scalar, broadcast the scalar with one insert and shuffle
+	llvm::VectorType *lhsVec = llvm::dyn_cast<llvm::VectorType>(lhs->getType());
+	llvm::VectorType *rhsVec = llvm::dyn_cast<llvm::VectorType>(rhs->getType());
+	if(lhsVec != NULL && rhsVec == NULL)
+		rhs = builder->CreateVectorSplat(lhsVec->getNumElements(), rhs);
+	else if(lhsVec == NULL && rhsVec != NULL)
+		lhs = builder->CreateVectorSplat(rhsVec->getNumElements(), lhs);
+
+	if(lhs->getType()->getScalarType()->isFloatingPointTy())
+	{
+		Assert(entry->floatOp != llvm::Instruction::BinaryOpsEnd);
+		return builder->CreateBinOp(entry->floatOp, lhs, rhs);
+	}
+	if(isUnsigned)
+		return builder->CreateBinOp(entry->unsignedOp, lhs, rhs);
+
+	return builder->CreateBinOp(entry->intOp, lhs, rhs);
+}
+
+/* Comparison lowering table
+ * -------------------------
+ * One entry per relational operator with the predicates for signed and
+ * unsigned integers and for floats, and the built-in function that does
+ * the same comparison component-wise (lessThan(a, b) is a < b).
+ */
+struct ComparisonOp {
+  const char *op;
+  const char *builtin;
+  llvm::CmpInst::Predicate intPred;
+  llvm::CmpInst::Predicate unsignedPred;
+  llvm::CmpInst::Predicate floatPred;
+};
+
+static const ComparisonOp comparisonOps[] = {
+  { "<",  "lessThan",         llvm::CmpInst::ICMP_SLT, llvm::CmpInst::ICMP_ULT, llvm::CmpInst::FCMP_OLT },
+  { "<=", "lessThanEqual",    llvm::CmpInst::ICMP_SLE, llvm::CmpInst::ICMP_ULE, llvm::CmpInst::FCMP_OLE },
+  { ">",  "greaterThan",      llvm::CmpInst::ICMP_SGT, llvm::CmpInst::ICMP_UGT, llvm::CmpInst::FCMP_OGT },
+  { ">=", "greaterThanEqual", llvm::CmpInst::ICMP_SGE, llvm::CmpInst::ICMP_UGE, llvm::CmpInst::FCMP_OGE },
+  { "==", "equal",            llvm::CmpInst::ICMP_EQ,  llvm::CmpInst::ICMP_EQ,  llvm::CmpInst::FCMP_OEQ },
+  { "!=", "notEqual",         llvm::CmpInst::ICMP_NE,  llvm::CmpInst::ICMP_NE,  llvm::CmpInst::FCMP_UNE },
+  { NULL, NULL,               llvm::CmpInst::ICMP_EQ,  llvm::CmpInst::ICMP_EQ,  llvm::CmpInst::FCMP_OEQ }
+};
+
+llvm::Value *IRGenerator::CreateComparison(const char *op, llvm::Value *lhs, llvm::Value *rhs, bool isUnsigned)
+{
+	const ComparisonOp *entry = comparisonOps;
+	while(entry->op != NULL && strcmp(entry->op, op) != 0)
+		entry++;
+	Assert(entry->op != NULL);
+
+	//vector and scalar, compare every lane with the scalar
+	llvm::VectorType *lhsVec = llvm::dyn_cast<llvm::VectorType>(lhs->getType());
+	llvm::VectorType *rhsVec = llvm::dyn_cast<llvm::VectorType>(rhs->getType());
+	if(lhsVec != NULL && rhsVec == NULL)
+		rhs = builder->CreateVectorSplat(lhsVec->getNumElements(), rhs);
+	else if(lhsVec == NULL && rhsVec != NULL)
+		lhs = builder->CreateVectorSplat(rhsVec->getNumElements(), lhs);
+
+	if(lhs->getType()->getScalarType()->isFloatingPointTy())
+		return builder->CreateFCmp(entry->floatPred, lhs, rhs);
+	if(isUnsigned)
+		return builder->CreateICmp(entry->unsignedPred, lhs, rhs);
+
+	return builder->CreateICmp(entry->intPred, lhs, rhs);
+}
+
+llvm::Value *IRGenerator::CreateMatrixArithmetic(const char *op, llvm::Value *lhs, llvm::Value *rhs)
+{
+	llvm::ArrayType *lhsMat = llvm::dyn_cast<llvm::ArrayType>(lhs->getType());
+	llvm::ArrayType *rhsMat = llvm::dyn_cast<llvm::ArrayType>(rhs->getType());
+
+	if(strcmp(op, "*") == 0 && lhsMat != NULL && rhsMat != NULL)
+	{
+		//column j of the product is lhs times column j of rhs
+		llvm::Value *result = llvm::UndefValue::get(rhsMat);
+		for(unsigned col = 0; col < rhsMat->getNumElements(); col++)
+		{
+			llvm::Value *column = builder->CreateExtractValue(rhs, col);
+			result = builder->CreateInsertValue(result, CreateMatrixTimesVector(lhs, column), col);
+		}
+		return result;
+	}
+	if(strcmp(op, "*") == 0 && lhsMat != NULL && rhs->getType()->isVectorTy())
+		return CreateMatrixTimesVector(lhs, rhs);
+
+	if(strcmp(op, "*") == 0 && lhs->getType()->isVectorTy() && rhsMat != NULL)
+	{
+		//row vector, component j is the dot product with column j
+		llvm::Value *result = llvm::UndefValue::get(lhs->getType());
+		for(unsigned col = 0; col < rhsMat->getNumElements(); col++)
+		{
+			llvm::Value *column = builder->CreateExtractValue(rhs, col);
+			result = builder->CreateInsertElement(result, CreateDot(lhs, column), llvm::ConstantInt::get(GetIntType(), col));
+		}
+		return result;
+	}
+
+	//component-wise, column by column; a scalar applies to every column
+	llvm::ArrayType *matType = lhsMat != NULL ? lhsMat : rhsMat;
+	llvm::Value *result = llvm::UndefValue::get(matType);
+	for(unsigned col = 0; col < matType->getNumElements(); col++)
+	{
+		llvm::Value *left = lhsMat != NULL ? builder->CreateExtractValue(lhs, col) : lhs;
+		llvm::Value *right = rhsMat != NULL ? builder->CreateExtractValue(rhs, col) : rhs;
+		result = builder->CreateInsertValue(result, CreateArithmetic(op, left, right), col);
+	}
+	return result;
+}
+
+llvm::Value *IRGenerator::CreateMatrixTimesVector(llvm::Value *matrix, llvm::Value *vector)
+{
+	//sum of the columns scaled by the vector components: a multiply for
+	//the first column and one multiply-add per column after it, each with
+	//the component broadcast, so mat4 * vec4 is four vector multiply-adds;
+	//they are fused into fmuladd only where contraction is allowed
+	llvm::ArrayType *matType = llvm::cast<llvm::ArrayType>(matrix->getType());
+	unsigned width = llvm::cast<llvm::VectorType>(matType->getElementType())->getNumElements();
+
+	llvm::Value *result = NULL;
+	for(unsigned col = 0; col < matType->getNumElements(); col++)
+	{
+		llvm::Value *column = builder->CreateExtractValue(matrix, col);
+		llvm::Value *component = builder->CreateExtractElement(vector, llvm::ConstantInt::get(GetIntType(), col));
+		llvm::Value *scale = builder->CreateVectorSplat(width, component);
+
+		if(result == NULL)
+			result = builder->CreateFMul(column, scale);
+		else if(contract)
+			result = CreateFMulAdd(column, scale, result);
+		else
+			result = builder->CreateFAdd(builder->CreateFMul(column, scale), result);
+	}
+	return result;
+}
+
+llvm::Value *IRGenerator::CreateFMulAdd(llvm::Value *a, llvm::Value *b, llvm::Value *c)
+{
+	//llvm.fmuladd lets the backend fuse when the target has fma
+	llvm::Value *args[] = { a, b, c };
+	return CreateIntrinsic(llvm::Intrinsic::fmuladd, args);
+}
+
+//overloaded intrinsics used here all take the type of their first operand
+llvm::Value *IRGenerator::CreateIntrinsic(llvm::Intrinsic::ID id, llvm::ArrayRef<llvm::Value *> args)
+{
+	llvm::Type *types[] = { args[0]->getType() };
+	llvm::Function *intrinsic = llvm::Intrinsic::getDeclaration(module, id, types);
+
+	//constant arguments fold like the builder folds everything else, vectors
+	//lane by lane with the scalar intrinsic
+	std::vector<llvm::Constant *> constArgs;
+	for(unsigned i = 0; i < args.size(); i++)
+	{
+		if(llvm::Constant *arg = llvm::dyn_cast<llvm::Constant>(args[i]))
+			constArgs.push_back(arg);
+	}
+
+	if(constArgs.size() == args.size())
+	{
+		llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(types[0]);
+		if(vecType == NULL)
+		{
+			if(llvm::Constant *folded = llvm::ConstantFoldCall(intrinsic, constArgs))
+				return folded;
+		}
+		else
+		{
+			llvm::Type *scalarTypes[] = { vecType->getElementType() };
+			llvm::Function *scalar = llvm::Intrinsic::getDeclaration(module, id, scalarTypes);
+
+			std::vector<llvm::Constant *> lanes;
+			for(unsigned lane = 0; lane < vecType->getNumElements(); lane++)
+			{
+				std::vector<llvm::Constant *> laneArgs;
+				for(unsigned i = 0; i < constArgs.size(); i++)
+					laneArgs.push_back(constArgs[i]->getAggregateElement(lane));
+
+				llvm::Constant *folded = llvm::ConstantFoldCall(scalar, laneArgs);
+				if(folded == NULL)
+					break;
+				lanes.push_back(folded);
+			}
+
+			if(lanes.size() == vecType->getNumElements())
+				return llvm::ConstantVector::get(lanes);
+		}
+	}
+
+	return builder->CreateCall(intrinsic, args);
+}
+
+llvm::Value *IRGenerator::CreateDot(llvm::Value *lhs, llvm::Value *rhs)
+{
+	llvm::Value *product = builder->CreateFMul(lhs, rhs);
+	llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(product->getType());
+	if(vecType == NULL)
+		return product;
+
+	//pad to a power of two with zero lanes, then add the upper half onto
+	//the lower half until one lane is left
+	unsigned width = vecType->getNumElements();
+	unsigned padded = 1;
+	while(padded < width)
+		padded *= 2;
+
+	if(padded != width)
+	{
+		std::vector<llvm::Constant *> mask;
+		for(unsigned lane = 0; lane < padded; lane++)
+			mask.push_back(llvm::ConstantInt::get(GetIntType(), lane < width ? lane : width));
+		llvm::Value *zero = llvm::Constant::getNullValue(vecType);
+		product = builder->CreateShuffleVector(product, zero, llvm::ConstantVector::get(mask));
+	}
+
+	for(unsigned half = padded / 2; half > 0; half /= 2)
+	{
+		std::vector<llvm::Constant *> mask;
+		for(unsigned lane = 0; lane < padded; lane++)
+		{
+			if(lane < half)
+				mask.push_back(llvm::ConstantInt::get(GetIntType(), lane + half));
+			else
+				mask.push_back(llvm::UndefValue::get(GetIntType()));
+		}
+		llvm::Value *upper = builder->CreateShuffleVector(product, llvm::UndefValue::get(product->getType()), llvm::ConstantVector::get(mask));
+		product = builder->CreateFAdd(product, upper);
+	}
+
+	return builder->CreateExtractElement(product, llvm::ConstantInt::get(GetIntType(), 0));
+}
+
+//shufflevector mask constant, negative entries are undef lanes
+static llvm::Constant *GetShuffleMask(llvm::LLVMContext &context, llvm::ArrayRef<int> mask)
+{
+	llvm::Type *intType = llvm::Type::getInt32Ty(context);
+
+	std::vector<llvm::Constant *> lanes;
+	for(unsigned i = 0; i < mask.size(); i++)
+	{
+		if(mask[i] < 0)
+			lanes.push_back(llvm::UndefValue::get(intType));
+		else
+			lanes.push_back(llvm::ConstantInt::get(intType, mask[i]));
+	}
+
+	return llvm::ConstantVector::get(lanes);
+}
+
+llvm::Value *IRGenerator::CreateSwizzle(llvm::Value *vector, llvm::ArrayRef<int> mask)
+{
+	if(mask.size() == 1)
+		return builder->CreateExtractElement(vector, llvm::ConstantInt::get(GetIntType(), mask[0]));
+
+	llvm::Value *undef = llvm::UndefValue::get(vector->getType());
+	return builder->CreateShuffleVector(vector, undef, GetShuffleMask(*context, mask));
+}
+
+llvm::Value *IRGenerator::CreateSwizzleBlend(llvm::Value *vector, llvm::Value *value, llvm::ArrayRef<int> mask)
+{
+	unsigned width = llvm::cast<llvm::VectorType>(vector->getType())->getNumElements();
+
+	if(mask.size() == 1)
+		return builder->CreateInsertElement(vector, value, llvm::ConstantInt::get(GetIntType(), mask[0]));
+
+	//lane of the value that holds component i
+	std::vector<int> source(mask.size());
+	for(unsigned i = 0; i < mask.size(); i++)
+		source[i] = i;
+
+	//narrower value, widen it so component i sits in lane mask[i]
+	if(llvm::cast<llvm::VectorType>(value->getType())->getNumElements() != width)
+	{
+		std::vector<int> widen(width, -1);
+		for(unsigned i = 0; i < mask.size(); i++)
+		{
+			widen[mask[i]] = i;
+			source[i] = mask[i];
+		}
+
+		value = builder->CreateShuffleVector(value, llvm::UndefValue::get(value->getType()), GetShuffleMask(*context, widen));
+	}
+
+	//blend: written lanes come from the value, the rest from the old vector
+	std::vector<int> blend(width);
+	for(unsigned i = 0; i < width; i++)
+		blend[i] = i;
+	for(unsigned i = 0; i < mask.size(); i++)
+		blend[mask[i]] = width + source[i];
+
+	return builder->CreateShuffleVector(vector, value, GetShuffleMask(*context, blend));
+}
+
+void IRGenerator::SetLoopHints(llvm::BranchInst *latch, int unrollCount, int vectorizeWidth)
+{
+	if(unrollCount < 0 && vectorizeWidth < 0)
+		return;
+
+	llvm::Type *intType = GetIntType();
+
+	//operand 0 is the loop id itself, filled in once the node exists
+	std::vector<llvm::Metadata *> hints;
+	llvm::TempMDNode temp = llvm::MDNode::getTemporary(*context, llvm::None);
+	hints.push_back(temp.get());
+
+	if(unrollCount == 0)
+	{
+		llvm::Metadata *disable[] = { llvm::MDString::get(*context, "llvm.loop.unroll.disable") };
+		hints.push_back(llvm::MDNode::get(*context, disable));
+	}
+	else if(unrollCount > 0)
+	{
+		llvm::Metadata *count[] = { llvm::MDString::get(*context, "llvm.loop.unroll.count"),
+		                            llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(intType, unrollCount)) };
+		hints.push_back(llvm::MDNode::get(*context, count));
+	}
+
+	//width 1 turns the vectorizer off for the loop
+	if(vectorizeWidth >= 0)
+	{
+		llvm::Metadata *width[] = { llvm::MDString::get(*context, "llvm.loop.vectorize.width"),
+		                            llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(intType, vectorizeWidth)) };
+		llvm::Metadata *enable[] = { llvm::MDString::get(*context, "llvm.loop.vectorize.enable"),
+		                             llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(GetBoolType(), vectorizeWidth > 1)) };
+		hints.push_back(llvm::MDNode::get(*context, width));
+		hints.push_back(llvm::MDNode::get(*context, enable));
+	}
+
+	llvm::MDNode *loopID = llvm::MDNode::get(*context, hints);
+	loopID->replaceOperandWith(0, loopID);
+	latch->setMetadata("llvm.loop", loopID);
+}
+
+//scalar conversion between bool, int and float
+llvm::Value *IRGenerator::CreateConversion(llvm::Value *value, llvm::Type *type, bool isUnsigned)
+{
+	llvm::Type *from = value->getType();
+	if(from == type)
+		return value;
+
+	if(type->isFloatingPointTy())
+	{
+		if(from == GetBoolType() || isUnsigned)
+			return builder->CreateUIToFP(value, type);
+		return builder->CreateSIToFP(value, type);
+	}
+
+	if(from->isFloatingPointTy())
+	{
+		if(type == GetBoolType())
+			return builder->CreateFCmpUNE(value, llvm::ConstantFP::get(from, 0.0));
+		if(isUnsigned)
+			return builder->CreateFPToUI(value, type);
+		return builder->CreateFPToSI(value, type);
+	}
+
+	if(type == GetBoolType())
+		return builder->CreateICmpNE(value, llvm::ConstantInt::get(from, 0));
+
+	return builder->CreateZExt(value, type);
+}
+
+/* Built-in function table
+ * -----------------------
+ * One entry per built-in with its argument count and how it is lowered:
+ * straight to an intrinsic overloaded on the argument type, or to an
+ * inline sequence.  Integer abs/min/max/clamp use compares and selects,
+ * and the relational built-ins come from the comparison table.
+ */
+enum BuiltinLowering {
+  BuiltinIntrinsic, BuiltinFract, BuiltinClamp, BuiltinMix,
+  BuiltinDot, BuiltinLength, BuiltinNormalize, BuiltinCross,
+  BuiltinAny, BuiltinAll, BuiltinNot
+};
+
+struct BuiltinFunction {
+  const char *name;
+  unsigned numArgs;
+  BuiltinLowering lowering;
+  llvm::Intrinsic::ID intrinsic;
+};
+
+static const BuiltinFunction builtinFunctions[] = {
+  { "sqrt",      1, BuiltinIntrinsic, llvm::Intrinsic::sqrt },
+  { "pow",       2, BuiltinIntrinsic, llvm::Intrinsic::pow },
+  { "abs",       1, BuiltinIntrinsic, llvm::Intrinsic::fabs },
+  { "floor",     1, BuiltinIntrinsic, llvm::Intrinsic::floor },
+  { "min",       2, BuiltinIntrinsic, llvm::Intrinsic::minnum },
+  { "max",       2, BuiltinIntrinsic, llvm::Intrinsic::maxnum },
+  { "fract",     1, BuiltinFract,     llvm::Intrinsic::not_intrinsic },
+  { "clamp",     3, BuiltinClamp,     llvm::Intrinsic::not_intrinsic },
+  { "mix",       3, BuiltinMix,       llvm::Intrinsic::not_intrinsic },
+  { "dot",       2, BuiltinDot,       llvm::Intrinsic::not_intrinsic },
+  { "length",    1, BuiltinLength,    llvm::Intrinsic::not_intrinsic },
+  { "normalize", 1, BuiltinNormalize, llvm::Intrinsic::not_intrinsic },
+  { "cross",     2, BuiltinCross,     llvm::Intrinsic::not_intrinsic },
+  { "any",       1, BuiltinAny,       llvm::Intrinsic::not_intrinsic },
+  { "all",       1, BuiltinAll,       llvm::Intrinsic::not_intrinsic },
+  { "not",       1, BuiltinNot,       llvm::Intrinsic::not_intrinsic },
+  { NULL,        0, BuiltinIntrinsic, llvm::Intrinsic::not_intrinsic }
+};
+
+int IRGenerator::GetBuiltinArgCount(const char *name)
+{
+	for(const ComparisonOp *cmp = comparisonOps; cmp->op != NULL; cmp++)
+	{
+		if(strcmp(cmp->builtin, name) == 0)
+			return 2;
+	}
+
+	for(const BuiltinFunction *entry = builtinFunctions; entry->name != NULL; entry++)
+	{
+		if(strcmp(entry->name, name) == 0)
+			return entry->numArgs;
+	}
+
+	return -1;
+}
+
+llvm::Value *IRGenerator::CreateBuiltin(const char *name, llvm::ArrayRef<llvm::Value *> args, bool isUnsigned)
+{
+	//component-wise comparisons, lessThan(a, b) etc.
+	for(const ComparisonOp *cmp = comparisonOps; cmp->op != NULL; cmp++)
+	{
+		if(strcmp(cmp->builtin, name) != 0)
+			continue;
+
+		Assert(args.size() == 2);
+		return CreateComparison(cmp->op, args[0], args[1], isUnsigned);
+	}
+
+	const BuiltinFunction *entry = builtinFunctions;
+	while(entry->name != NULL && strcmp(entry->name, name) != 0)
+		entry++;
+	if(entry->name == NULL)
+		return NULL;
+	Assert(args.size() == entry->numArgs);
+
+	//the first argument decides the type, scalars after it are converted
+	//and broadcast (clamp(v, 0.0, 1.0), mix(a, b, 0.5), max(v, 0))
+	llvm::Type *type = args[0]->getType();
+	std::vector<llvm::Value *> values;
+	for(unsigned i = 0; i < args.size(); i++)
+		values.push_back(CreateBroadcast(args[i], type, isUnsigned));
+
+	if(type->getScalarType() == GetIntType())
+	{
+		llvm::Value *zero = llvm::Constant::getNullValue(type);
+		if(strcmp(name, "abs") == 0)
+			return builder->CreateSelect(CreateComparison("<", values[0], zero, false), builder->CreateNeg(values[0]), values[0]);
+		if(strcmp(name, "min") == 0)
+			return builder->CreateSelect(CreateComparison("<", values[0], values[1], isUnsigned), values[0], values[1]);
+		if(strcmp(name, "max") == 0)
+			return builder->CreateSelect(CreateComparison(">", values[0], values[1], isUnsigned), values[0], values[1]);
+		if(strcmp(name, "clamp") == 0)
+		{
+			llvm::Value *low = builder->CreateSelect(CreateComparison(">", values[0], values[1], isUnsigned), values[0], values[1]);
+			return builder->CreateSelect(CreateComparison("<", low, values[2], isUnsigned), low, values[2]);
+		}
+
+		//the rest is only defined for floats
+		Assert(!type->isVectorTy());
+		type = GetFloatType();
+		for(unsigned i = 0; i < values.size(); i++)
+			values[i] = CreateConversion(values[i], type, isUnsigned);
+	}
+
+	switch(entry->lowering)
+	{
+	case BuiltinIntrinsic:
+		return CreateIntrinsic(entry->intrinsic, values);
+
+	case BuiltinFract:
+	{
+		llvm::Value *floor = CreateIntrinsic(llvm::Intrinsic::floor, values[0]);
+		return builder->CreateFSub(values[0], floor);
+	}
+
+	case BuiltinClamp:
+	{
+		llvm::Value *low[] = { values[0], values[1] };
+		llvm::Value *high[] = { CreateIntrinsic(llvm::Intrinsic::maxnum, low), values[2] };
+		return CreateIntrinsic(llvm::Intrinsic::minnum, high);
+	}
+
+	case BuiltinMix:
+	{
+		//x + (y - x) * a, fused only where contraction is allowed
+		llvm::Value *delta = builder->CreateFSub(values[1], values[0]);
+		if(contract)
+			return CreateFMulAdd(delta, values[2], values[0]);
+
+		return builder->CreateFAdd(builder->CreateFMul(delta, values[2]), values[0]);
+	}
+
+	case BuiltinDot:
+		return CreateDot(values[0], values[1]);
+
+	case BuiltinLength:
+		return CreateIntrinsic(llvm::Intrinsic::sqrt, CreateDot(values[0], values[0]));
+
+	case BuiltinNormalize:
+	{
+		llvm::Value *length = CreateIntrinsic(llvm::Intrinsic::sqrt, CreateDot(values[0], values[0]));
+		llvm::Value *scale = builder->CreateFDiv(llvm::ConstantFP::get(GetFloatType(), 1.0), length);
+		return builder->CreateFMul(values[0], CreateBroadcast(scale, type));
+	}
+
+	case BuiltinAny:
+	case BuiltinAll:
+	{
+		//the lanes of a bvec as the bits of one integer, one compare tests
+		//them all
+		llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(type);
+		if(vecType == NULL)
+			return values[0];
+
+		llvm::Type *bitsType = llvm::IntegerType::get(*context, vecType->getNumElements());
+		llvm::Value *bits = builder->CreateBitCast(values[0], bitsType);
+		if(entry->lowering == BuiltinAny)
+			return builder->CreateICmpNE(bits, llvm::Constant::getNullValue(bitsType));
+		return builder->CreateICmpEQ(bits, llvm::Constant::getAllOnesValue(bitsType));
+	}
+
+	case BuiltinNot:
+		return builder->CreateNot(values[0]);
+
+	case BuiltinCross:
+	{
+		//a.yzx * b.zxy - a.zxy * b.yzx
+		int yzx[] = { 1, 2, 0 };
+		int zxy[] = { 2, 0, 1 };
+		llvm::Value *left = builder->CreateFMul(CreateSwizzle(values[0], yzx), CreateSwizzle(values[1], zxy));
+		llvm::Value *right = builder->CreateFMul(CreateSwizzle(values[0], zxy), CreateSwizzle(values[1], yzx));
+		return builder->CreateFSub(left, right);
+	}
+	}
+
+	return NULL;
+}
+
+//scalar converted to the component type of type, and splat if a vector
+llvm::Value *IRGenerator::CreateBroadcast(llvm::Value *value, llvm::Type *type, bool isUnsigned)
+{
+	if(value->getType() == type || value->getType()->isVectorTy())
+		return value;
+
+	value = CreateConversion(value, type->getScalarType(), isUnsigned);
+	llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(type);
+	if(vecType == NULL)
+		return value;
+
+	return builder->CreateVectorSplat(vecType->getNumElements(), value);
+}
+
+llvm::Value *IRGenerator::CreateArrayConstructor(llvm::ArrayType *type, llvm::ArrayRef<llvm::Value *> args, bool isUnsigned)
+{
+	Assert(args.size() == type->getNumElements());
+
+	//each element converted once
+	llvm::Type *elemType = type->getElementType();
+	std::vector<llvm::Value *> elements;
+	std::vector<llvm::Constant *> constants;
+	for(unsigned i = 0; i < args.size(); i++)
+	{
+		llvm::Value *value = args[i];
+		if(value->getType() != elemType)
+			value = CreateConstructor(elemType, value, isUnsigned);
+
+		elements.push_back(value);
+		if(llvm::Constant *constant = llvm::dyn_cast<llvm::Constant>(value))
+			constants.push_back(constant);
+	}
+
+	//a table of constants is a single ConstantDataArray
+	if(constants.size() == elements.size())
+		return llvm::ConstantArray::get(type, constants);
+
+	llvm::Value *array = llvm::UndefValue::get(type);
+	for(unsigned i = 0; i < elements.size(); i++)
+		array = builder->CreateInsertValue(array, elements[i], i);
+	return array;
+}
+
+llvm::Value *IRGenerator::CreateConstructor(llvm::Type *type, llvm::ArrayRef<llvm::Value *> args, bool isUnsigned)
+{
+	Assert(args.size() > 0);
+
+	if(args.size() == 1 && args[0]->getType() == type)
+		return args[0];
+
+	//components of all arguments, in order; matrices column by column
+	std::vector<llvm::Value *> components;
+	for(unsigned i = 0; i < args.size(); i++)
+	{
+		std::vector<llvm::Value *> columns;
+		llvm::ArrayType *argMat = llvm::dyn_cast<llvm::ArrayType>(args[i]->getType());
+		if(argMat != NULL)
+		{
+			for(unsigned col = 0; col < argMat->getNumElements(); col++)
+				columns.push_back(builder->CreateExtractValue(args[i], col));
+		}
+		else
+			columns.push_back(args[i]);
+
+		for(unsigned col = 0; col < columns.size(); col++)
+		{
+			llvm::VectorType *argVec = llvm::dyn_cast<llvm::VectorType>(columns[col]->getType());
+			if(argVec == NULL)
+			{
+				components.push_back(columns[col]);
+				continue;
+			}
+
+			for(unsigned lane = 0; lane < argVec->getNumElements(); lane++)
+				components.push_back(builder->CreateExtractElement(columns[col], llvm::ConstantInt::get(GetIntType(), lane)));
+		}
+	}
+
+	llvm::ArrayType *matType = llvm::dyn_cast<llvm::ArrayType>(type);
+	if(matType != NULL)
+	{
+		llvm::VectorType *colType = llvm::cast<llvm::VectorType>(matType->getElementType());
+		unsigned height = colType->getNumElements();
+		bool diagonal = args.size() == 1 && components.size() == 1;
+		if(!diagonal)
+			Assert(components.size() >= matType->getNumElements() * height);
+
+		//one scalar goes on the diagonal, everything else fills the
+		//columns in order
+		llvm::Value *matrix = llvm::UndefValue::get(matType);
+		for(unsigned col = 0; col < matType->getNumElements(); col++)
+		{
+			llvm::Value *column;
+			if(diagonal)
+			{
+				llvm::Value *value = CreateConversion(components[0], colType->getElementType(), isUnsigned);
+				column = builder->CreateInsertElement(llvm::Constant::getNullValue(colType), value, llvm::ConstantInt::get(GetIntType(), col));
+			}
+			else
+				column = CreateConstructor(colType, llvm::makeArrayRef(&components[col * height], height), isUnsigned);
+
+			matrix = builder->CreateInsertValue(matrix, column, col);
+		}
+		return matrix;
+	}
+
+	llvm::Type *elemType = type->getScalarType();
+	llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(type);
+	if(vecType == NULL)
+		return CreateConversion(components[0], elemType, isUnsigned);
+
+	unsigned width = vecType->getNumElements();
+	if(args.size() == 1 && !args[0]->getType()->isVectorTy())
+		return builder->CreateVectorSplat(width, CreateConversion(args[0], elemType, isUnsigned));
+
+	Assert(components.size() >= width);
 
-	 if(llvm::ConstantFP::classof(value))
-		return true;
-	else if(llvm::GetElementPtrInst::classof(value))
-		return true;
-	else if(llvm::ExtractElementInst::classof(value))
-		return true;
+	llvm::Value *vector = llvm::UndefValue::get(vecType);
+	for(unsigned i = 0; i < width; i++)
+		vector = builder->CreateInsertElement(vector, CreateConversion(components[i], elemType, isUnsigned), llvm::ConstantInt::get(GetIntType(), i));
 
-	return false;
+	return vector;
 }
 
 
@@ -16,6 +16,12 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+
+#include <map>
+#include <set>
+#include <vector>
 
 
 class IRGenerator {
@@ -33,6 +39,10 @@ class IRGenerator {
     llvm::BasicBlock *GetBasicBlock() const;
     void        SetBasicBlock(llvm::BasicBlock *bb);
 
+    // all instructions are created through the builder, which folds
+    // constant operands and inserts at the end of the current block
+    llvm::IRBuilder<> *GetBuilder() const { return builder; }
+
     llvm::Type *GetIntType();
     llvm::Type *GetBoolType();
     llvm::Type *GetFloatType();
@@ -40,9 +50,77 @@ class IRGenerator {
 	llvm::Type *GetVec2Type();
 	llvm::Type *GetVec3Type();
 	llvm::Type *GetVec4Type();
+	llvm::Type *GetIntVecType(int width);
+	llvm::Type *GetBoolVecType(int width);
+	llvm::Type *GetMat2Type();
+	llvm::Type *GetMat3Type();
+	llvm::Type *GetMat4Type();
 	llvm::Type *GetType(llvm::Value *value);
 	bool IsFloatType(llvm::Value *value);
 
+	// stores are volatile only for variables marked volatile, unless
+	// -fvolatile-stores asks for the old every-store-volatile codegen
+	llvm::StoreInst *CreateStore(llvm::Value *value, llvm::Value *ptr);
+	void MarkVolatile(llvm::Value *var);
+	bool IsVolatile(llvm::Value *ptr) const;
+
+	// locals live in SSA registers: the code generator tracks the current
+	// definition of every variable per basic block and places phis itself.
+	// Arrays, volatile variables and -fno-ssa still get a stack slot.
+	llvm::Value *CreateLocal(llvm::Type *type, const char *name, bool isVolatile);
+	llvm::Value *CreateLoad(llvm::Value *ptr);
+	bool IsSSAVariable(llvm::Value *var) const;
+
+	// a block is sealed once all of its predecessors are known
+	void SealBlock(llvm::BasicBlock *bb);
+	void FinishFunction();
+
+	// arithmetic lowering: the instruction is picked from the operator and
+	// the shapes of both operands, a scalar operand is broadcast to the
+	// width of a vector one (vec3 * float -> fmul <3 x float> with a splat).
+	// Matrices are arrays of column vectors: * with a matrix operand is the
+	// linear algebra product, everything else is done column by column
+	llvm::Value *CreateArithmetic(const char *op, llvm::Value *lhs, llvm::Value *rhs, bool isUnsigned = false);
+
+	// comparisons, component-wise for vectors (the result is then a bvec)
+	llvm::Value *CreateComparison(const char *op, llvm::Value *lhs, llvm::Value *rhs, bool isUnsigned);
+
+	// a * b + c through llvm.fmuladd, and a dot product with a shuffle tree
+	llvm::Value *CreateFMulAdd(llvm::Value *a, llvm::Value *b, llvm::Value *c);
+	llvm::Value *CreateDot(llvm::Value *lhs, llvm::Value *rhs);
+
+	// built-in functions (dot, clamp, sqrt, ...) lowered to intrinsics or
+	// inline vector code; NULL if name is not a built-in
+	llvm::Value *CreateBuiltin(const char *name, llvm::ArrayRef<llvm::Value *> args, bool isUnsigned);
+	int GetBuiltinArgCount(const char *name);	//-1 if not a built-in
+
+	// swizzles: one extractelement or shufflevector for a read, and for a
+	// write one blend of the new components into the old vector
+	llvm::Value *CreateSwizzle(llvm::Value *vector, llvm::ArrayRef<int> mask);
+	llvm::Value *CreateSwizzleBlend(llvm::Value *vector, llvm::Value *value, llvm::ArrayRef<int> mask);
+
+	// float semantics of the function being emitted: the fast-math flags
+	// picked with -ffast-math (or -freassoc, -farcp, -fnnan, -fninf) go on
+	// every float instruction, -fcontract fuses a * b + c into fmuladd,
+	// reassociation lets v * s1 * s2 multiply the scalars first and
+	// -fdenormal-flush flushes denormals; precise functions stay strict IEEE
+	void SetFloatSemantics(llvm::Function *func, bool precise);
+	bool AllowContraction() const { return contract; }
+	bool AllowReassociation() const { return reassociate; }
+
+	// loop hints from #pragma unroll/nounroll/vectorize, attached to the
+	// back edge as llvm.loop metadata (-1: no hint, unroll count 0: nounroll)
+	void SetLoopHints(llvm::BranchInst *latch, int unrollCount, int vectorizeWidth);
+
+	// constructors of built-in types: the components of all arguments in
+	// order, converted to the component type; one scalar fills a vector,
+	// or the diagonal of a matrix.  isUnsigned: the integers converted from
+	// or to are uint
+	llvm::Value *CreateConstructor(llvm::Type *type, llvm::ArrayRef<llvm::Value *> args, bool isUnsigned = false);
+
+	// array constructors, float[3](a, b, c): one argument per element
+	llvm::Value *CreateArrayConstructor(llvm::ArrayType *type, llvm::ArrayRef<llvm::Value *> args, bool isUnsigned = false);
+
 	//static llvm::Type* GetLlvmType(llvm::Value *value);
 
   private:
@@ -52,6 +130,33 @@ class IRGenerator {
     // track which function or basic block is active
     llvm::Function    *currentFunc;
     llvm::BasicBlock  *currentBB;
+    llvm::IRBuilder<> *builder;
+
+    // a * b + c may become one llvm.fmuladd in the current function
+    bool contract;
+    bool reassociate;
+
+    // variables declared with the volatile qualifier
+    std::set<llvm::Value *> volatileVars;
+
+    // SSA construction state, reset at the end of every function
+    typedef std::map<llvm::BasicBlock *, llvm::Value *> DefMap;
+    std::map<llvm::Value *, DefMap> currentDef;
+    std::map<llvm::BasicBlock *, std::map<llvm::Value *, llvm::PHINode *> > incompletePhis;
+    std::set<llvm::BasicBlock *> sealedBlocks;
+    std::set<llvm::Value *> ssaVars;
+
+    llvm::Value *ReadVariable(llvm::Value *var, llvm::BasicBlock *bb);
+    llvm::Value *ReadVariableRecursive(llvm::Value *var, llvm::BasicBlock *bb);
+    void WriteVariable(llvm::Value *var, llvm::BasicBlock *bb, llvm::Value *value);
+    llvm::Value *AddPhiOperands(llvm::Value *var, llvm::PHINode *phi);
+    llvm::Value *TryRemoveTrivialPhi(llvm::PHINode *phi);
+
+    llvm::Value *CreateConversion(llvm::Value *value, llvm::Type *type, bool isUnsigned = false);
+    llvm::Value *CreateMatrixArithmetic(const char *op, llvm::Value *lhs, llvm::Value *rhs);
+    llvm::Value *CreateMatrixTimesVector(llvm::Value *matrix, llvm::Value *vector);
+    llvm::Value *CreateIntrinsic(llvm::Intrinsic::ID id, llvm::ArrayRef<llvm::Value *> args);
+    llvm::Value *CreateBroadcast(llvm::Value *value, llvm::Type *type, bool isUnsigned = false);
 
     static const char *TargetTriple;
     static const char *TargetLayout;
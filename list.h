@@ -33,6 +33,7 @@
 using namespace std;
 
 class Node;
+class NodeVisitor;
 
 template<class Element> class List {
 
@@ -53,6 +54,12 @@ template<class Element> class List {
 	{ Assert(index >= 0 && index < NumElements());
 	  return elems[index]; }
 
+          // Replaces element at index
+          // Raises assert if index out of range
+    void SetNth(int index, const Element &elem)
+	{ Assert(index >= 0 && index < NumElements());
+	  elems[index] = elem; }
+
           // Inserts element at index, shuffling over others
           // Raises assert if index out of range
     void InsertAt(const Element &elem, int index)
@@ -80,6 +87,9 @@ template<class Element> class List {
     void PrintAll(int indentLevel, const char *label = NULL)
         { for (int i = 0; i < NumElements(); i++)
              Nth(i)->Print(indentLevel, label); }
+    void WalkAll(NodeVisitor *visitor)
+        { for (int i = 0; i < NumElements(); i++)
+             Nth(i)->Walk(visitor); }
              
 
 };
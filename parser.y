@@ -53,6 +53,7 @@ void yyerror(const char *msg); // standard error-handling routine
     List<VarDecl *> *varDeclList;
     List<Stmt*> *stmtList;
     Stmt       *stmt;
+    LoopStmt   *loopStmt;
     Operator *ops;
     Identifier *funcId;
     List<Expr*> *argList;
@@ -71,7 +72,7 @@ void yyerror(const char *msg); // standard error-handling routine
 %token   T_Mat2  T_Mat3 T_Mat4
 %token   T_While T_For T_If T_Else T_Return T_Break T_Continue T_Do 
 %token   T_Switch T_Case T_Default
-%token   T_In T_Out T_Const T_Uniform
+%token   T_In T_Out T_Const T_Uniform T_Volatile T_Precise
 %token   T_LeftParen T_RightParen T_LeftBracket T_RightBracket T_LeftBrace T_RightBrace
 %token   T_Dot T_Comma T_Colon T_Semicolon T_Question
 
@@ -80,20 +81,26 @@ void yyerror(const char *msg); // standard error-handling routine
 %token   <identifier> T_Plus T_Star
 %token   <identifier> T_MulAssign T_DivAssign T_AddAssign T_SubAssign T_Equal
 %token   <identifier> T_LeftAngle T_RightAngle T_Dash T_Slash
+%token   <identifier> T_Percent T_LeftOp T_RightOp T_Ampersand T_VerticalBar T_Caret T_Tilde
+%token   <identifier> T_ModAssign T_LeftAssign T_RightAssign T_AndAssign T_OrAssign T_XorAssign
 %token   <identifier> T_Inc T_Dec 
 %token   <identifier> T_Identifier
 %token   <integerConstant> T_IntConstant
 %token   <floatConstant> T_FloatConstant
 %token   <boolConstant> T_BoolConstant
 %token   <identifier> T_FieldSelection
+%token   <integerConstant> T_PragmaUnroll T_PragmaVectorize
+%token   T_PragmaNoUnroll
 
 %nonassoc LOWEST
 %nonassoc LOWER_THAN_ELSE
 %nonassoc T_Else
 %right T_Equal T_MulAssign T_DivAssign T_AddAssign T_SubAssign
+%right T_ModAssign T_LeftAssign T_RightAssign T_AndAssign T_OrAssign T_XorAssign
 %right T_Question T_Colon
 %left T_EQ T_NE T_LeftAngle T_RightAngle T_And T_Or T_GreaterEqual
-%left T_Plus T_Dash T_Star T_Slash
+%left T_VerticalBar T_Caret T_Ampersand T_LeftOp T_RightOp
+%left T_Plus T_Dash T_Star T_Slash T_Percent
 
 /* Non-terminal types
  * ------------------
@@ -114,12 +121,14 @@ void yyerror(const char *msg); // standard error-handling routine
 %type <typeQualifier> TypeQualify
 %type <expression> PrimaryExpr PostfixExpr UnaryExpr MultiExpr AdditionExpr RelationExpr Initializer FunctionCallExpr FunctionCallHeaderWithParameters FunctionCallHeaderNoParameters
 %type <expression> EqualityExpr LogicAndExpr LogicOrExpr Expression
+%type <expression> ShiftExpr AndExpr ExclusiveOrExpr InclusiveOrExpr
  /*%type <floatConstant> Initializer*/
 %type <varDecl>    SingleDecl
 %type <varDeclList> ParameterList
 %type <stmt>       Statement
 %type <stmtList>   StatementList
-%type <stmt>       SingleStatement SelectionStmt SwitchStmt CaseStmt JumpStmt WhileStmt ForStmt
+%type <stmt>       SingleStatement SelectionStmt SwitchStmt CaseStmt JumpStmt
+%type <loopStmt>   LoopStatement WhileStmt ForStmt
 %type <stmt>       CompoundStatement
 %type <ops>        AssignOp
 %type <funcId>     FunctionIdentifier
@@ -187,6 +196,17 @@ FuncDecl  : TypeDecl T_Identifier T_LeftParen T_RightParen
                             Identifier *id = new Identifier(yylloc, (const char *)$2); 
                             $$ = new FnDecl(id, $1, $4);
                          }
+          | TypeQualify TypeDecl T_Identifier T_LeftParen T_RightParen
+                         {
+                            Identifier *id = new Identifier(yylloc, (const char *)$3);
+                            List<VarDecl *> *formals = new List<VarDecl *>;
+                            $$ = new FnDecl(id, $2, $1, formals);
+                         }
+          | TypeQualify TypeDecl T_Identifier T_LeftParen ParameterList T_RightParen
+                         {
+                            Identifier *id = new Identifier(yylloc, (const char *)$3);
+                            $$ = new FnDecl(id, $2, $1, $5);
+                         }
           ;
 
 ParameterList : SingleDecl { ($$ = new List<VarDecl *>)->Append($1);  }
@@ -205,7 +225,6 @@ SingleDecl    : TypeDecl T_Identifier
                          }
               | TypeDecl T_Identifier T_Equal Initializer
                          {
-                            // incomplete: drop the initializer here
                             Identifier *id = new Identifier(yylloc, (const char *)$2); 
                             $$ = new VarDecl(id, $1, $4);
                          }
@@ -224,6 +243,16 @@ SingleDecl    : TypeDecl T_Identifier
                             Identifier *id = new Identifier(@3, $3);
                             $$ = new VarDecl(id, new ArrayType(@2, $2, $5), $1);
                          }
+              | TypeDecl T_Identifier T_LeftBracket T_IntConstant T_RightBracket T_Equal Initializer
+                         {
+                            Identifier *id = new Identifier(@2, (const char *)$2);
+                            $$ = new VarDecl(id, new ArrayType(@1, $1, $4), $7);
+                         }
+              | TypeQualify TypeDecl T_Identifier T_LeftBracket T_IntConstant T_RightBracket T_Equal Initializer
+                         {
+                            Identifier *id = new Identifier(@3, $3);
+                            $$ = new VarDecl(id, new ArrayType(@2, $2, $5), $1, $8);
+                         }
 
               ;
 
@@ -234,15 +263,27 @@ TypeQualify    : T_In       {$$ = TypeQualifier::inTypeQualifier;}
                | T_Out      {$$ = TypeQualifier::outTypeQualifier;}
                | T_Const    {$$ = TypeQualifier::constTypeQualifier;}
                | T_Uniform  {$$ = TypeQualifier::uniformTypeQualifier;}
+               | T_Volatile {$$ = TypeQualifier::volatileTypeQualifier;}
+               | T_Precise  {$$ = TypeQualifier::preciseTypeQualifier;}
                ;
 
 TypeDecl       : T_Int                   { $$ = Type::intType;    }
                | T_Void                  { $$ = Type::voidType;   }
                | T_Float                 { $$ = Type::floatType;  }
                | T_Bool                  { $$ = Type::boolType;   }
+               | T_Uint                  { $$ = Type::uintType;   }
                | T_Vec2                  { $$ = Type::vec2Type;   }
                | T_Vec3                  { $$ = Type::vec3Type;   }
                | T_Vec4                  { $$ = Type::vec4Type;   }
+               | T_Ivec2                 { $$ = Type::ivec2Type;  }
+               | T_Ivec3                 { $$ = Type::ivec3Type;  }
+               | T_Ivec4                 { $$ = Type::ivec4Type;  }
+               | T_Uvec2                 { $$ = Type::uvec2Type;  }
+               | T_Uvec3                 { $$ = Type::uvec3Type;  }
+               | T_Uvec4                 { $$ = Type::uvec4Type;  }
+               | T_Bvec2                 { $$ = Type::bvec2Type;  }
+               | T_Bvec3                 { $$ = Type::bvec3Type;  }
+               | T_Bvec4                 { $$ = Type::bvec4Type;  }
                | T_Mat2                  { $$ = Type::mat2Type;   }
                | T_Mat3                  { $$ = Type::mat3Type;   }
                | T_Mat4                  { $$ = Type::mat4Type;   }
@@ -270,8 +311,7 @@ SingleStatement   : T_Semicolon      { $$ = new EmptyExpr();  }
                   | SwitchStmt       { $$ = $1; }
                   | CaseStmt         { $$ = $1; }
                   | JumpStmt         { $$ = $1; }
-                  | WhileStmt        { $$ = $1; }
-                  | ForStmt          { $$ = $1; }
+                  | LoopStatement    { $$ = $1; }
                   ;
 
 SelectionStmt     : T_If T_LeftParen Expression T_RightParen Statement T_Else Statement
@@ -299,6 +339,14 @@ JumpStmt           : T_Break   T_Semicolon    { $$ = new BreakStmt(yylloc); }
                    | T_Return Expression T_Semicolon { $$ = new ReturnStmt(yyloc, $2); }
                    ; 
 
+/* loop hints, #pragma lines right before the loop */
+LoopStatement      : WhileStmt        { $$ = $1; }
+                   | ForStmt          { $$ = $1; }
+                   | T_PragmaUnroll LoopStatement    { ($$ = $2)->SetUnrollCount($1); }
+                   | T_PragmaNoUnroll LoopStatement  { ($$ = $2)->SetUnrollCount(0); }
+                   | T_PragmaVectorize LoopStatement { ($$ = $2)->SetVectorizeWidth($1); }
+                   ;
+
 WhileStmt          : T_While T_LeftParen Expression T_RightParen Statement { $$ = new WhileStmt($3, $5); }
                    ;
 
@@ -319,6 +367,11 @@ PrimaryExpr        : T_Identifier    { Identifier *id = new Identifier(yylloc, (
 
 FunctionCallExpr     : FunctionCallHeaderWithParameters T_RightParen { $$ = $1; }
                      | FunctionCallHeaderNoParameters T_RightParen   { $$ = $1; }
+                     | TypeDecl T_LeftParen ArgumentList T_RightParen { $$ = new ConstructorExpr(@1, $1, $3); }
+                     | TypeDecl T_LeftBracket T_IntConstant T_RightBracket T_LeftParen ArgumentList T_RightParen
+                                   {
+                                      $$ = new ConstructorExpr(@1, new ArrayType(@1, $1, $3), $6);
+                                   }
                      ;
 
 FunctionCallHeaderNoParameters     : FunctionIdentifier T_LeftParen T_Void { $$ = new Call(@1, NULL, $1, new List<Expr*>); }
@@ -378,6 +431,11 @@ UnaryExpr          : PostfixExpr     { $$ = $1; }
                              Operator *op = new Operator(yylloc, $1);
                              $$ = new ArithmeticExpr(op, $2);
                            }
+                   | T_Tilde UnaryExpr
+                           {
+                             Operator *op = new Operator(yylloc, $1);
+                             $$ = new ArithmeticExpr(op, $2);
+                           }
                    ;
 
 MultiExpr          : UnaryExpr       { $$ = $1; }
@@ -391,6 +449,11 @@ MultiExpr          : UnaryExpr       { $$ = $1; }
                              Operator *op = new Operator(yylloc, $2);
                              $$ = new ArithmeticExpr($1, op, $3);
                            }
+                   | MultiExpr T_Percent UnaryExpr
+                           {
+                             Operator *op = new Operator(yylloc, $2);
+                             $$ = new ArithmeticExpr($1, op, $3);
+                           }
                    ;
 
 AdditionExpr       : MultiExpr       { $$ = $1; }
@@ -406,23 +469,36 @@ AdditionExpr       : MultiExpr       { $$ = $1; }
                            }
                    ;
 
-RelationExpr       : AdditionExpr       { $$ = $1; }
-                   | RelationExpr T_LeftAngle AdditionExpr
+ShiftExpr          : AdditionExpr       { $$ = $1; }
+                   | ShiftExpr T_LeftOp AdditionExpr
+                           {
+                             Operator *op = new Operator(yylloc, $2);
+                             $$ = new ArithmeticExpr($1, op, $3);
+                           }
+                   | ShiftExpr T_RightOp AdditionExpr
+                           {
+                             Operator *op = new Operator(yylloc, $2);
+                             $$ = new ArithmeticExpr($1, op, $3);
+                           }
+                   ;
+
+RelationExpr       : ShiftExpr          { $$ = $1; }
+                   | RelationExpr T_LeftAngle ShiftExpr
                            {
                              Operator *op = new Operator(yylloc, $2);
                              $$ = new RelationalExpr($1, op, $3);
                            }
-                   | RelationExpr T_RightAngle AdditionExpr
+                   | RelationExpr T_RightAngle ShiftExpr
                            {
                              Operator *op = new Operator(yylloc, $2);
                              $$ = new RelationalExpr($1, op, $3);
                            }
-                   | RelationExpr T_GreaterEqual AdditionExpr
+                   | RelationExpr T_GreaterEqual ShiftExpr
                            {
                              Operator *op = new Operator(yylloc, $2);
                              $$ = new RelationalExpr($1, op, $3);
                            }
-                   | RelationExpr T_LessEqual AdditionExpr
+                   | RelationExpr T_LessEqual ShiftExpr
                            {
                              Operator *op = new Operator(yylloc, $2);
                              $$ = new RelationalExpr($1, op, $3);
@@ -442,8 +518,32 @@ EqualityExpr       : RelationExpr       { $$ = $1; }
                            }
                    ;
 
-LogicAndExpr       : EqualityExpr       { $$ = $1; }
-                   | LogicAndExpr T_And EqualityExpr
+AndExpr            : EqualityExpr       { $$ = $1; }
+                   | AndExpr T_Ampersand EqualityExpr
+                           {
+                             Operator *op = new Operator(yylloc, $2);
+                             $$ = new ArithmeticExpr($1, op, $3);
+                           }
+                   ;
+
+ExclusiveOrExpr    : AndExpr            { $$ = $1; }
+                   | ExclusiveOrExpr T_Caret AndExpr
+                           {
+                             Operator *op = new Operator(yylloc, $2);
+                             $$ = new ArithmeticExpr($1, op, $3);
+                           }
+                   ;
+
+InclusiveOrExpr    : ExclusiveOrExpr    { $$ = $1; }
+                   | InclusiveOrExpr T_VerticalBar ExclusiveOrExpr
+                           {
+                             Operator *op = new Operator(yylloc, $2);
+                             $$ = new ArithmeticExpr($1, op, $3);
+                           }
+                   ;
+
+LogicAndExpr       : InclusiveOrExpr    { $$ = $1; }
+                   | LogicAndExpr T_And InclusiveOrExpr
                            {
                              Operator *op = new Operator(yylloc, $2);
                              $$ = new LogicalExpr($1, op, $3);
@@ -474,6 +574,12 @@ AssignOp           : T_Equal         { $$ = new Operator(yylloc, $1);   }
                    | T_SubAssign     { $$ = new Operator(yylloc, "-=");  }
                    | T_MulAssign     { $$ = new Operator(yylloc, "*=");  }
                    | T_DivAssign     { $$ = new Operator(yylloc, "/=");  }
+                   | T_ModAssign     { $$ = new Operator(yylloc, "%=");  }
+                   | T_LeftAssign    { $$ = new Operator(yylloc, "<<="); }
+                   | T_RightAssign   { $$ = new Operator(yylloc, ">>="); }
+                   | T_AndAssign     { $$ = new Operator(yylloc, "&=");  }
+                   | T_OrAssign      { $$ = new Operator(yylloc, "|=");  }
+                   | T_XorAssign     { $$ = new Operator(yylloc, "^=");  }
                    ;
 
 %%
@@ -0,0 +1,560 @@
+/* File: passes.cc
+ * ---------------
+ * Implementation of the module-level passes run before the bitcode
+ * is written out.
+ */
+
+#include "passes.h"
+#include "utility.h"
+#include <string.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <stdint.h>
+
+#include "llvm/Pass.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Vectorize.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+
+
+/* Pass table
+ * ----------
+ * Every pass that can appear in a pipeline, by the name used on the
+ * command line (the same names opt uses).  The creators are wrapped so
+ * they all share one signature regardless of their default arguments.
+ */
+static llvm::Pass *CreateMem2Reg()      { return llvm::createPromoteMemoryToRegisterPass(); }
+static llvm::Pass *CreateSROA()         { return llvm::createSROAPass(); }
+static llvm::Pass *CreateInstCombine()  { return llvm::createInstructionCombiningPass(); }
+static llvm::Pass *CreateReassociate()  { return llvm::createReassociatePass(); }
+static llvm::Pass *CreateEarlyCSE()     { return llvm::createEarlyCSEPass(); }
+static llvm::Pass *CreateGVN()          { return llvm::createGVNPass(); }
+static llvm::Pass *CreateSCCP()         { return llvm::createSCCPPass(); }
+static llvm::Pass *CreateDSE()          { return llvm::createDeadStoreEliminationPass(); }
+static llvm::Pass *CreateADCE()         { return llvm::createAggressiveDCEPass(); }
+static llvm::Pass *CreateSimplifyCFG()  { return llvm::createCFGSimplificationPass(); }
+static llvm::Pass *CreateLoopRotate()   { return llvm::createLoopRotatePass(); }
+static llvm::Pass *CreateLICM()         { return llvm::createLICMPass(); }
+static llvm::Pass *CreateIndVars()      { return llvm::createIndVarSimplifyPass(); }
+static llvm::Pass *CreateLoopUnroll()   { return llvm::createLoopUnrollPass(); }
+static llvm::Pass *CreateLoopVectorize(){ return llvm::createLoopVectorizePass(); }
+static llvm::Pass *CreateSLPVectorizer(){ return llvm::createSLPVectorizerPass(); }
+
+struct PassEntry {
+  const char *name;
+  llvm::Pass *(*create)();
+};
+
+static const PassEntry passTable[] = {
+  { "mem2reg",        CreateMem2Reg },
+  { "sroa",           CreateSROA },
+  { "instcombine",    CreateInstCombine },
+  { "reassociate",    CreateReassociate },
+  { "early-cse",      CreateEarlyCSE },
+  { "gvn",            CreateGVN },
+  { "sccp",           CreateSCCP },
+  { "dse",            CreateDSE },
+  { "adce",           CreateADCE },
+  { "simplifycfg",    CreateSimplifyCFG },
+  { "loop-rotate",    CreateLoopRotate },
+  { "licm",           CreateLICM },
+  { "indvars",        CreateIndVars },
+  { "loop-unroll",    CreateLoopUnroll },
+  { "loop-vectorize", CreateLoopVectorize },
+  { "slp-vectorizer", CreateSLPVectorizer },
+  { NULL,             NULL }
+};
+
+/* Default pipelines
+ * -----------------
+ * Indexed by the -O level.  -O1 only cleans up what the code generator
+ * emits, -O2 adds redundancy elimination and the loop passes, -O3 runs
+ * a second round of scalar cleanup after the vectorizers.
+ */
+static const char *defaultPipelines[] = {
+  "",
+  "mem2reg,instcombine,simplifycfg",
+  "sroa,early-cse,instcombine,simplifycfg,reassociate,gvn,"
+  "loop-rotate,licm,indvars,loop-unroll,loop-vectorize,slp-vectorizer,"
+  "instcombine,simplifycfg",
+  "sroa,early-cse,sccp,instcombine,simplifycfg,reassociate,gvn,"
+  "loop-rotate,licm,indvars,loop-unroll,loop-vectorize,slp-vectorizer,"
+  "instcombine,gvn,dse,adce,simplifycfg"
+};
+
+static const PassEntry *LookupPass(const std::string &name)
+{
+	for(int i = 0; passTable[i].name != NULL; i++)
+	{
+		if(name == passTable[i].name)
+			return &passTable[i];
+	}
+
+	return NULL;
+}
+
+//target machine for the module's triple, NULL if the target is not linked in
+static llvm::TargetMachine *CreateTargetMachine(llvm::Module *mod)
+{
+	llvm::InitializeNativeTarget();
+
+	std::string error;
+	const llvm::Target *target = llvm::TargetRegistry::lookupTarget(mod->getTargetTriple(), error);
+	if(target == NULL)
+		return NULL;
+
+	llvm::TargetOptions options;
+	return target->createTargetMachine(mod->getTargetTriple(), llvm::sys::getHostCPUName(), "", options);
+}
+
+void OptimizeModule(llvm::Module *mod)
+{
+	int level = GetIntOption("O", 0);
+	const char *pipeline = GetOption("passes");
+	if(pipeline == NULL)
+		pipeline = defaultPipelines[level];
+
+	if(pipeline[0] == '\0')
+		return;
+
+	llvm::TimePassesIsEnabled = IsOptionOn("time-passes");
+
+	llvm::legacy::PassManager pm;
+
+	//let the vectorizers and the unroller see the real vector width
+	llvm::TargetMachine *tm = CreateTargetMachine(mod);
+	if(tm != NULL)
+		pm.add(llvm::createTargetTransformInfoWrapperPass(tm->getTargetIRAnalysis()));
+
+	//add passes in the order given
+	std::string passes(pipeline);
+	size_t start = 0;
+	while(start <= passes.size())
+	{
+		size_t end = passes.find(',', start);
+		if(end == std::string::npos)
+			end = passes.size();
+
+		std::string name = passes.substr(start, end - start);
+		if(!name.empty())
+		{
+			const PassEntry *entry = LookupPass(name);
+			if(entry == NULL)
+				Failure("Unknown pass '%s' in -passes", name.c_str());
+
+			PrintDebug("passes", "adding pass %s", name.c_str());
+			pm.add(entry->create());
+		}
+
+		start = end + 1;
+	}
+
+	pm.run(*mod);
+
+	//the pass timers only report when their group is destroyed at
+	//llvm_shutdown, which glc never calls, so print them now
+	if(llvm::TimePassesIsEnabled)
+		llvm::TimerGroup::printAll(llvm::errs());
+
+	delete tm;
+}
+
+void ReportPromotableAllocas(llvm::Module *mod)
+{
+	for(llvm::Module::iterator f = mod->begin(); f != mod->end(); f++)
+	{
+		if(f->isDeclaration())
+			continue;
+
+		int allocas = 0, promotable = 0, arrays = 0;
+		for(llvm::Function::iterator b = f->begin(); b != f->end(); b++)
+		{
+			for(llvm::BasicBlock::iterator i = b->begin(); i != b->end(); i++)
+			{
+				if(llvm::AllocaInst *alloca = llvm::dyn_cast<llvm::AllocaInst>(&*i))
+				{
+					//arrays and matrices stay in memory on purpose, their
+					//element addresses keep mem2reg away
+					if(alloca->getAllocatedType()->isArrayTy())
+					{
+						arrays++;
+						continue;
+					}
+
+					allocas++;
+					if(llvm::isAllocaPromotable(alloca))
+						promotable++;
+				}
+			}
+		}
+
+		PrintStat("%s: %d allocas, %d promotable to registers, %d arrays", f->getName().str().c_str(), allocas, promotable, arrays);
+	}
+}
+
+//comma separated fields of a .dat line, surrounding blanks removed
+static void SplitFields(const std::string &line, std::vector<std::string> &fields)
+{
+	size_t start = 0;
+	while(start <= line.size())
+	{
+		size_t end = line.find(',', start);
+		if(end == std::string::npos)
+			end = line.size();
+
+		std::string field = line.substr(start, end - start);
+		size_t first = field.find_first_not_of(" \t\r\n");
+		size_t last = field.find_last_not_of(" \t\r\n");
+		if(first != std::string::npos)
+			fields.push_back(field.substr(first, last - first + 1));
+
+		start = end + 1;
+	}
+}
+
+//constant of a scalar or vector type from one text value per component,
+//NULL if the number of values does not match
+static llvm::Constant *ParseUniformValue(llvm::Type *type, const std::vector<std::string> &values)
+{
+	llvm::Type *elemType = type->getScalarType();
+	unsigned count = type->isVectorTy() ? type->getVectorNumElements() : 1;
+	if(values.size() != count)
+		return NULL;
+
+	std::vector<llvm::Constant *> lanes;
+	for(unsigned i = 0; i < count; i++)
+	{
+		const char *text = values[i].c_str();
+		if(elemType->isFloatingPointTy())
+			lanes.push_back(llvm::ConstantFP::get(elemType, strtod(text, NULL)));
+		else if(elemType->isIntegerTy(1))
+			lanes.push_back(llvm::ConstantInt::get(elemType, strcmp(text, "true") == 0 || atoi(text) != 0));
+		else if(elemType->isIntegerTy())
+			lanes.push_back(llvm::ConstantInt::get(elemType, strtol(text, NULL, 10), true));
+		else
+			return NULL;
+	}
+
+	if(!type->isVectorTy())
+		return lanes[0];
+
+	return llvm::ConstantVector::get(lanes);
+}
+
+//only read by the shader: every use is a load
+static bool IsReadOnly(llvm::GlobalVariable *gv)
+{
+	for(llvm::Value::user_iterator u = gv->user_begin(); u != gv->user_end(); u++)
+	{
+		if(!llvm::isa<llvm::LoadInst>(*u))
+			return false;
+	}
+
+	return true;
+}
+
+void SpecializeUniforms(llvm::Module *mod, const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if(file == NULL)
+		Failure("Could not open uniform file '%s'", path);
+
+	//values in file order
+	std::vector<llvm::GlobalVariable *> globals;
+	std::vector<llvm::Constant *> values;
+
+	char buf[1024];
+	while(fgets(buf, sizeof(buf), file) != NULL)
+	{
+		if(strncmp(buf, "gin:", 4) != 0)
+			continue;
+
+		//name, type, one value per component
+		std::vector<std::string> fields;
+		SplitFields(buf + 4, fields);
+		if(fields.size() < 3)
+			Failure("Malformed line in '%s': %s", path, buf);
+
+		llvm::GlobalVariable *gv = mod->getNamedGlobal(fields[0]);
+		if(gv == NULL)
+		{
+			PrintDebug("specialize", "no global %s, value ignored", fields[0].c_str());
+			continue;
+		}
+
+		llvm::Type *type = llvm::cast<llvm::PointerType>(gv->getType())->getElementType();
+		std::vector<std::string> text(fields.begin() + 2, fields.end());
+		llvm::Constant *value = ParseUniformValue(type, text);
+		if(value == NULL)
+			Failure("Value of '%s' in '%s' does not match its type", fields[0].c_str(), path);
+
+		if(!IsReadOnly(gv))
+		{
+			PrintStat("%s is written by the shader, not specialized", fields[0].c_str());
+			continue;
+		}
+
+		globals.push_back(gv);
+		values.push_back(value);
+	}
+	fclose(file);
+
+	if(globals.empty())
+		return;
+
+	//generic copy of every function, calls between copies stay generic
+	std::vector<llvm::Function *> functions;
+	std::set<llvm::Function *> generic;
+	llvm::ValueToValueMapTy vmap;
+	for(llvm::Module::iterator f = mod->begin(); f != mod->end(); f++)
+	{
+		if(!f->isDeclaration())
+			functions.push_back(&*f);
+	}
+
+	for(unsigned i = 0; i < functions.size(); i++)
+	{
+		llvm::Function *f = functions[i];
+		llvm::Function *copy = llvm::Function::Create(f->getFunctionType(), f->getLinkage(), f->getName() + ".generic", mod);
+		llvm::Function::arg_iterator arg = copy->arg_begin();
+		for(llvm::Function::arg_iterator a = f->arg_begin(); a != f->arg_end(); a++, arg++)
+		{
+			arg->setName(a->getName());
+			vmap[&*a] = &*arg;
+		}
+
+		vmap[f] = copy;
+		generic.insert(copy);
+	}
+
+	for(unsigned i = 0; i < functions.size(); i++)
+	{
+		llvm::SmallVector<llvm::ReturnInst *, 8> returns;
+		llvm::CloneFunctionInto(llvm::cast<llvm::Function>(vmap[functions[i]]), functions[i], vmap, false, returns);
+	}
+
+	//the specialized functions read an internal constant copy of each
+	//global, FNV-1a over the names and values identifies the set
+	uint64_t hash = 14695981039346656037ULL;
+	for(unsigned i = 0; i < globals.size(); i++)
+	{
+		llvm::GlobalVariable *gv = globals[i];
+		llvm::GlobalVariable *spec = new llvm::GlobalVariable(*mod, values[i]->getType(), true,
+			llvm::GlobalValue::InternalLinkage, values[i], gv->getName() + ".spec");
+
+		std::vector<llvm::User *> users(gv->user_begin(), gv->user_end());
+		for(unsigned u = 0; u < users.size(); u++)
+		{
+			llvm::Instruction *inst = llvm::cast<llvm::Instruction>(users[u]);
+			if(generic.count(inst->getParent()->getParent()) == 0)
+				inst->replaceUsesOfWith(gv, spec);
+		}
+
+		std::string text;
+		llvm::raw_string_ostream stream(text);
+		stream << gv->getName() << "=" << *values[i] << ";";
+		stream.flush();
+
+		for(unsigned c = 0; c < text.size(); c++)
+		{
+			hash ^= (unsigned char)text[c];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	//partially evaluate the specialized functions
+	llvm::legacy::FunctionPassManager fpm(mod);
+	fpm.add(llvm::createSCCPPass());
+	fpm.add(llvm::createInstructionCombiningPass());
+	fpm.add(llvm::createCFGSimplificationPass());
+
+	fpm.doInitialization();
+	for(unsigned i = 0; i < functions.size(); i++)
+		fpm.run(*functions[i]);
+	fpm.doFinalization();
+
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".spec-%016llx", (unsigned long long)hash);
+	mod->setModuleIdentifier(mod->getModuleIdentifier() + suffix);
+
+	PrintStat("specialized %d globals, %s", (int)globals.size(), mod->getModuleIdentifier().c_str());
+}
+
+void InternalizeModule(llvm::Module *mod, const char *entries)
+{
+	std::vector<std::string> names;
+	SplitFields(entries, names);
+	std::set<std::string> entryPoints(names.begin(), names.end());
+
+	for(llvm::Module::iterator f = mod->begin(); f != mod->end(); f++)
+	{
+		if(!f->isDeclaration() && entryPoints.count(f->getName().str()) == 0)
+			f->setLinkage(llvm::GlobalValue::InternalLinkage);
+	}
+
+	for(llvm::Module::global_iterator g = mod->global_begin(); g != mod->global_end(); g++)
+	{
+		if(g->hasInitializer())
+			g->setLinkage(llvm::GlobalValue::InternalLinkage);
+	}
+}
+
+//functions in post-order over the call graph, callees before callers;
+//GLSL has no recursion so the graph is a DAG
+static void PostOrder(llvm::Function *f, std::set<llvm::Function *> &visited, std::vector<llvm::Function *> &order)
+{
+	if(f->isDeclaration() || !visited.insert(f).second)
+		return;
+
+	for(llvm::Function::iterator b = f->begin(); b != f->end(); b++)
+	{
+		for(llvm::BasicBlock::iterator i = b->begin(); i != b->end(); i++)
+		{
+			if(llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(&*i))
+			{
+				if(llvm::Function *callee = call->getCalledFunction())
+					PostOrder(callee, visited, order);
+			}
+		}
+	}
+
+	order.push_back(f);
+}
+
+static void CallGraphOrder(llvm::Module *mod, std::vector<llvm::Function *> &order)
+{
+	std::set<llvm::Function *> visited;
+	for(llvm::Module::iterator f = mod->begin(); f != mod->end(); f++)
+		PostOrder(&*f, visited, order);
+}
+
+//stack slots are private to the call, everything else is a global
+static bool IsLocalMemory(llvm::Value *ptr)
+{
+	return llvm::isa<llvm::AllocaInst>(ptr->stripInBoundsOffsets());
+}
+
+void InferFunctionAttributes(llvm::Module *mod)
+{
+	std::vector<llvm::Function *> order;
+	CallGraphOrder(mod, order);
+
+	int readNone = 0, readOnly = 0;
+	for(unsigned n = 0; n < order.size(); n++)
+	{
+		llvm::Function *f = order[n];
+		bool reads = false, writes = false;
+
+		for(llvm::Function::iterator b = f->begin(); b != f->end(); b++)
+		{
+			for(llvm::BasicBlock::iterator i = b->begin(); i != b->end(); i++)
+			{
+				if(llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(&*i))
+					reads |= !IsLocalMemory(load->getPointerOperand()) || load->isVolatile();
+				else if(llvm::StoreInst *store = llvm::dyn_cast<llvm::StoreInst>(&*i))
+					writes |= !IsLocalMemory(store->getPointerOperand()) || store->isVolatile();
+				else if(llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(&*i))
+				{
+					//callees were done first, intrinsics carry their own
+					reads |= !call->doesNotAccessMemory();
+					writes |= !call->onlyReadsMemory();
+				}
+			}
+		}
+
+		//nothing in GLSL throws
+		f->setDoesNotThrow();
+		if(!reads && !writes)
+		{
+			f->setDoesNotAccessMemory();
+			readNone++;
+		}
+		else if(!writes)
+		{
+			f->setOnlyReadsMemory();
+			readOnly++;
+		}
+
+		PrintDebug("purity", "%s: %s", f->getName().str().c_str(),
+			!reads && !writes ? "readnone" : !writes ? "readonly" : "writes globals");
+	}
+
+	PrintStat("%d functions readnone, %d readonly", readNone, readOnly);
+}
+
+static unsigned FunctionSize(llvm::Function *f)
+{
+	unsigned size = 0;
+	for(llvm::Function::iterator b = f->begin(); b != f->end(); b++)
+		size += b->size();
+
+	return size;
+}
+
+void InlineFunctions(llvm::Module *mod)
+{
+	int threshold = GetIntOption("inline-threshold", GetIntOption("O", 0) > 0 ? 40 : 0);
+	if(threshold <= 0)
+		return;
+
+	//callees first, so a caller is measured with its own calls inlined
+	std::vector<llvm::Function *> order;
+	CallGraphOrder(mod, order);
+
+	int inlined = 0;
+	for(unsigned n = 0; n < order.size(); n++)
+	{
+		llvm::Function *f = order[n];
+
+		std::vector<llvm::CallInst *> calls;
+		for(llvm::Function::iterator b = f->begin(); b != f->end(); b++)
+		{
+			for(llvm::BasicBlock::iterator i = b->begin(); i != b->end(); i++)
+			{
+				llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(&*i);
+				if(call == NULL || call->getCalledFunction() == NULL || call->getCalledFunction()->isDeclaration())
+					continue;
+
+				//small functions and functions with one caller
+				llvm::Function *callee = call->getCalledFunction();
+				if(FunctionSize(callee) <= (unsigned)threshold || callee->hasOneUse())
+					calls.push_back(call);
+			}
+		}
+
+		for(unsigned c = 0; c < calls.size(); c++)
+		{
+			PrintDebug("inline", "%s into %s", calls[c]->getCalledFunction()->getName().str().c_str(), f->getName().str().c_str());
+
+			llvm::InlineFunctionInfo info;
+			if(llvm::InlineFunction(calls[c], info))
+				inlined++;
+		}
+	}
+
+	//internal functions that were inlined everywhere, callers first so
+	//the calls they still make go away before their callees are checked
+	int deleted = 0;
+	for(int n = (int)order.size() - 1; n >= 0; n--)
+	{
+		if(order[n]->hasLocalLinkage() && order[n]->use_empty())
+		{
+			order[n]->eraseFromParent();
+			deleted++;
+		}
+	}
+
+	PrintStat("%d calls inlined, %d functions deleted", inlined, deleted);
+}
@@ -0,0 +1,97 @@
+/**
+ * File: passes.h
+ * --------------
+ *  This file declares the module-level passes that run between code
+ *  generation (Program::Emit) and writing the bitcode out.
+ *
+ *  The optimization pipeline is a list of LLVM passes picked by name.
+ *  -O0 .. -O3 select one of the default lists below, -passes=<list>
+ *  replaces it with a custom one and -time-passes reports the time
+ *  spent in every pass once the compiler exits.
+ *
+ *  -specialize=<file> compiles the shader for one set of uniform values,
+ *  given as the gin: lines of a sample .dat file.
+ */
+
+#ifndef _H_passes
+#define _H_passes
+
+#include "llvm/IR/Module.h"
+
+/**
+ * Function: OptimizeModule()
+ * Usage: OptimizeModule(mod);
+ * ---------------------------
+ * Run the pass pipeline selected on the command line over the module.
+ * Does nothing at -O0 unless a pipeline was given with -passes.
+ */
+
+void OptimizeModule(llvm::Module *mod);
+
+/**
+ * Function: ReportPromotableAllocas()
+ * Usage: ReportPromotableAllocas(mod);
+ * ------------------------------------
+ * Print (with -stats) how many scalar and vector stack slots each
+ * function still has and how many of them mem2reg is able to promote to
+ * registers.  Volatile accesses are what keeps a slot from being
+ * promotable.  Arrays and matrices are counted apart, they are meant to
+ * stay in memory.
+ */
+
+void ReportPromotableAllocas(llvm::Module *mod);
+
+/**
+ * Function: SpecializeUniforms()
+ * Usage: SpecializeUniforms(mod, "shader.dat");
+ * ---------------------------------------------
+ * Bake the values of the global variables listed in the file
+ * ("gin: name, type, v1, v2, ...", other lines are ignored) into the
+ * code.  Every function keeps its name but reads the values from an
+ * internal constant copy of each global, and is partially evaluated
+ * with sccp, instcombine and simplifycfg.  The unspecialized code stays
+ * in the module as <name>.generic and still reads the globals.  Globals
+ * the shader writes are left alone.  The module identifier gets a
+ * ".spec-<hash>" suffix, a hash of the values, to cache specializations.
+ */
+
+void SpecializeUniforms(llvm::Module *mod, const char *path);
+
+/**
+ * Function: InternalizeModule()
+ * Usage: InternalizeModule(mod, "main,shade");
+ * --------------------------------------------
+ * Give internal linkage to every function not named in the comma
+ * separated list of entry points, and to every global variable defined
+ * in the module.  Uniforms without an initializer stay external since
+ * the runtime sets them by name.
+ */
+
+void InternalizeModule(llvm::Module *mod, const char *entries);
+
+/**
+ * Function: InferFunctionAttributes()
+ * Usage: InferFunctionAttributes(mod);
+ * ------------------------------------
+ * Walk the call graph bottom-up (GLSL has no recursion, so it is a DAG)
+ * and mark every function nounwind, and readnone or readonly when it
+ * does not touch global memory or only reads it.  Stack slots and the
+ * attributes of the callees are taken into account.
+ */
+
+void InferFunctionAttributes(llvm::Module *mod);
+
+/**
+ * Function: InlineFunctions()
+ * Usage: InlineFunctions(mod);
+ * ----------------------------
+ * Inline, bottom-up, every call to a function of at most
+ * -inline-threshold=<n> instructions (40 from -O1 on, 0 turns it off)
+ * or to a function with a single call site.  Internal functions left
+ * without callers are deleted.  -stats reports the number of calls
+ * inlined.
+ */
+
+void InlineFunctions(llvm::Module *mod);
+
+#endif
@@ -0,0 +1,29 @@
+#! /bin/sh
+#
+# IR check for the sample programs: every scalar and vector stack slot
+# glc emits must be promotable to a register, and none may be left after
+# -O1 (mem2reg).  Arrays and matrices are reported apart and not checked.
+
+[ -x glc ] || { echo "Error: glc not executable"; exit 1; }
+
+LIST=
+if [ "$#" = "0" ]; then
+	LIST=`ls public_samples/*.glsl`
+else
+	for test in "$@"; do
+		LIST="$LIST public_samples/$test.glsl"
+	done
+fi
+
+status=0
+for file in $LIST; do
+	echo $file
+	./glc -O0 -stats < $file 2>&1 >/dev/null | awk '
+		/allocas/ { if ($4 != $6) { print "  not promotable: " $0; bad = 1 } }
+		END { exit bad }' || status=1
+	./glc -O1 -stats < $file 2>&1 >/dev/null | awk '
+		/allocas/ { if ($4 != 0) { print "  left after mem2reg: " $0; bad = 1 } }
+		END { exit bad }' || status=1
+done
+
+exit $status
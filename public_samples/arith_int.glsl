@@ -0,0 +1,12 @@
+int ints(int x)
+{
+  int y;
+
+  y = 3;
+  y += x * 2;
+  y -= x / 2;
+  y *= y - x;
+  y /= 4;
+
+  return y + x * y - y / x;
+}
@@ -0,0 +1,22 @@
+int arith_ivec(int k)
+{
+  ivec3 a = ivec3(k, 2 * k, -k);
+  ivec3 b = ivec3(2);
+  ivec3 r;
+  uvec2 u;
+
+  r = a + b * k;
+  r = r - a / b;
+  r = k * r - 1;
+  r = 100 - r;
+  r = r % ivec3(10, 7, 4);
+
+  r += a;
+  r *= 2;
+  r /= ivec3(k);
+
+  u = uvec2(k, 7) * uvec2(5);
+  u = u / 2;
+
+  return r.x + r.y * 10 + r.z * 100 + int(u.x) + int(u.y) * 1000;
+}
@@ -0,0 +1,18 @@
+float arith_matrix(float s)
+{
+  mat2 a = mat2(1.0, 2.0, 3.0, 4.0);
+  mat2 b = mat2(s);
+  mat2 c;
+
+  c = a + b;
+  c = c - a * 0.5;
+  c = s * c;
+  c = c / s + 1.0;
+  c = 10.0 - c;
+
+  c += b;
+  c *= a;
+  c -= s;
+
+  return c[0][0] + c[0][1] + c[1][0] + c[1][1];
+}
@@ -0,0 +1,27 @@
+vec3 a;
+vec3 b;
+
+float shapes(float s)
+{
+  vec3 r;
+  vec2 q;
+  float t;
+
+  t = (s + 0.5) + (s - 0.5) + (s * 0.5) + (s / 0.5);
+
+  r = (a + b) + (b - a) + (a * b) + (b / a);
+  t = t + r.x + r.y + r.z;
+
+  r = (a + s) + (a - s) + (a * s) + (a / s);
+  t = t + r.x + r.y + r.z;
+
+  r = (s + a) + (s - a) + (s * a) + (s / a);
+  t = t + r.x + r.y + r.z;
+
+  q = (a.xy + b.yz) - (a.zx * s) + (s / b.xy);
+  t = t + q.x + q.y;
+
+  t = t + a.z * b.x - b.y / a.z;
+
+  return t;
+}
@@ -0,0 +1,29 @@
+vec4 c;
+
+float compound(float s)
+{
+  vec4 v;
+  vec2 w;
+  float t;
+
+  v = c;
+  v += c;
+  v *= s;
+  v -= 1.0;
+  v /= c;
+
+  v.xy += s;
+  v.wz *= c.xy;
+  v.y -= 0.5;
+  v.x /= s;
+
+  w = v.zw;
+  w -= v.xy;
+
+  t = s;
+  t *= 4.0;
+  t += w.x + w.y;
+  t -= v.x;
+
+  return t + v.y + v.z;
+}
@@ -0,0 +1,18 @@
+int bitwise(int x)
+{
+  int h;
+  uint u;
+  ivec2 v;
+
+  h = x * 7 % 5;
+  h = h | (x << 4);
+  h ^= 6;
+  h = h & ~2;
+  h >>= 1;
+  h %= 7;
+
+  u = uint(-16) >> 28;
+  v = ivec2(x, 12) & 6;
+
+  return h + (-16 >> 2) + int(u) + v.y;
+}
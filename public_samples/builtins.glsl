@@ -0,0 +1,19 @@
+vec3 p;
+
+float builtins(float s)
+{
+  vec3 n;
+  float r;
+
+  r = dot(p, vec3(1.0, 2.0, 3.0)) + length(vec3(2.0, 3.0, 6.0));
+
+  n = clamp(p, 1.5, 2.5);
+  r += n.x + n.z;
+
+  r += mix(2.0, 4.0, 0.25) + fract(2.75) + abs(-s) + pow(s, 3.0);
+
+  n = cross(vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0));
+  r += n.z + float(max(3, 5)) + min(s, 1);
+
+  return r;
+}
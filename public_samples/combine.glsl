@@ -0,0 +1,18 @@
+vec3 p;
+
+float combine(float s)
+{
+  vec3 v;
+
+  v.x = s * 0.5;
+  v.y = s * 2.0;
+  v.zx = vec2(4.0, 1.0);
+
+  p.x = v.y;
+  p.z = 3.0;
+
+  v.y = 0.5;
+  v.z = v.y * 2.0;
+
+  return v.x + v.y + v.z + p.x + p.y + p.z;
+}
@@ -0,0 +1,12 @@
+const float g = sqrt(16.0) * 2.0;
+const mat2 m = mat2(1.0, 2.0, 3.0, 4.0);
+bool big = max(g, 1.0) > 4.0;
+
+float const_data(int i)
+{
+  float r = g + m[i][1] + m[1][0];
+
+  if (big)
+    r = r + 1.0;
+  return r;
+}
@@ -0,0 +1,13 @@
+const float scale = 0.5;
+const vec3 weights = vec3(1.0, 2.0, 4.0) * scale;
+const float bias = weights.z - weights.x;
+
+float const_fold(float s)
+{
+  const int count = 3;
+  vec3 v = vec3(s);
+  float r = bias * float(count);
+
+  v = v * weights;
+  return v.x + v.y + v.z + r + vec2(2.0, 8.0).y;
+}
@@ -0,0 +1,12 @@
+int guard_divide(int n)
+{
+  int b = n - 3;
+  int r = 0;
+
+  if (b != 0 && 12 / b > 1)
+    r += 1;
+  if (b == 0 || 12 % b == 0)
+    r += 10;
+
+  return r + (b != 0 ? 12 / b : 100);
+}
@@ -0,0 +1,18 @@
+float guard_index(int n)
+{
+  float a[4];
+  float r = 0.0;
+  int i = n + 2;
+
+  a[0] = 1.0;
+  a[1] = 2.0;
+  a[2] = 3.0;
+  a[3] = 4.0;
+
+  if (i < 4 && a[i] > 0.0)
+    r += 1.0;
+  if (i >= 4 || a[i] < 0.0)
+    r += 10.0;
+
+  return r + (i < 4 ? a[i] : 100.0);
+}
@@ -0,0 +1,28 @@
+int intvec(int k)
+{
+  ivec3 b;
+  uvec2 u;
+  bvec3 c;
+  int r;
+
+  b = ivec3(k, -k, 2 * k) + ivec3(1);
+  b.xz = b.zx / 2;
+  c = lessThan(b, ivec3(0));
+
+  r = b.x + b.y * 10 + b.z * 100;
+  if (any(c))
+    r += 1000;
+  if (all(c))
+    r += 5000;
+  if (b.y < 0)
+    r += 1;
+
+  u = uvec2(-2, 2);
+  if (u.x / u.y > 1000)
+    r += 10000;
+
+  if (c == bvec3(false, true, false))
+    r += 100000;
+
+  return r;
+}
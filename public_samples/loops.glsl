@@ -0,0 +1,25 @@
+float loops(float s, int n)
+{
+  float sum;
+  int i;
+  int j;
+
+  sum = 0.0;
+  for (i = 0; i < n; i++)
+  {
+    j = 0;
+    while (j < i)
+    {
+      if (j == 3)
+        break;
+      sum = sum + s;
+      j++;
+    }
+  }
+
+  i = 10;
+  while (i < n)
+    sum = sum + 100.0;
+
+  return sum;
+}
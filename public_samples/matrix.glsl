@@ -0,0 +1,17 @@
+vec3 p;
+
+float matrix(float s)
+{
+  mat3 m;
+  mat2 n;
+  vec3 v;
+  vec2 w;
+
+  m = mat3(1.0, 2.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, s);
+  v = m * p;
+  w = vec2(p.x, p.y) * mat2(1.0, 2.0, 3.0, 4.0);
+  n = mat2(s) * mat2(1.0, 0.0, 1.0, 1.0);
+  m[1] = v;
+
+  return v.x + v.y * 2.0 + v.z * 4.0 + w.x + w.y + n[1][0] + m[1][1];
+}
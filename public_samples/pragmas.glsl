@@ -0,0 +1,21 @@
+float pragmas(float s)
+{
+  float a[8];
+  float sum;
+  int i;
+
+  #pragma vectorize(4)
+  for (i = 0; i < 8; i++)
+    a[i] = s * float(i);
+
+  sum = 0.0;
+  #pragma unroll(2)
+  for (i = 0; i < 8; i++)
+    sum = sum + a[i];
+
+  #pragma nounroll
+  while (i > 6)
+    i--;
+
+  return sum + float(i);
+}
@@ -0,0 +1,14 @@
+vec4 p;
+
+float scale(vec4 v, float s)
+{
+  return dot(v, v) * s - s;
+}
+
+precise float precise_sum(float s)
+{
+  vec4 v;
+
+  v = p * s + p;
+  return scale(v, 0.5) + v.x * v.y - v.z;
+}
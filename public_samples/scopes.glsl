@@ -0,0 +1,22 @@
+float scopes(float s)
+{
+  float r;
+
+  if (s > 1.0) {
+    float t = 1.0;
+    r = t;
+  } else {
+    float t = 2.0;
+    r = t;
+  }
+
+  if (s < 1.0) {
+    float t = 10.0;
+    r = r + t;
+  } else {
+    float t = 20.0;
+    r = r + t;
+  }
+
+  return r;
+}
@@ -0,0 +1,26 @@
+float count;
+
+bool bump()
+{
+  count = count + 1.0;
+  return true;
+}
+
+float short_circuit(float x)
+{
+  bool a;
+  bool b;
+  float r;
+
+  count = 0.0;
+  a = x > 1.0 || bump();
+  b = x < 1.0 && bump();
+  r = x > 0.0 ? x * 2.0 : (bump() ? 1.0 : 0.0);
+
+  if (a && b == false)
+    r += 10.0;
+  if (x > 1.0 && bump())
+    r += 100.0;
+
+  return r + count;
+}
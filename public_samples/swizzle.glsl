@@ -0,0 +1,20 @@
+vec4 p;
+
+float swizzle(float s)
+{
+  vec4 v;
+  vec3 u;
+  vec2 w;
+
+  v = p;
+  w = v.zyx.xy;
+  u = v.wzy;
+
+  v.zx = w;
+  v.wzyx = v;
+  u.yz *= s;
+  v.xyz += u.zyx;
+  v.zyx.xy = w;
+
+  return v.x + v.y * 2.0 + v.z * 4.0 + v.w * 8.0 + u.x;
+}
@@ -0,0 +1,8 @@
+const float w[5] = float[5](1.0, 2.0, 4.0, 8.0, 16.0);
+
+float table(int i)
+{
+  float k[3] = float[3](0.5, 1.0, 2);
+
+  return w[i] + w[2] * k[1] + k[i - 2];
+}
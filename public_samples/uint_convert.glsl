@@ -0,0 +1,7 @@
+float uint_convert(float s)
+{
+  uint u = uint(-2);
+  uint v = uint(s * 1500000000.0);
+
+  return float(u) / 1073741824.0 + float(v / 1000000000);
+}
@@ -0,0 +1,19 @@
+float unroll(float s)
+{
+  float a[4];
+  float sum;
+  int i;
+
+  for (i = 0; i < 4; i++)
+    a[i] = s * float(i);
+
+  sum = 0.0;
+  for (i = 3; i >= 0; i -= 1)
+  {
+    if (i == 1)
+      continue;
+    sum = sum + a[i];
+  }
+
+  return sum + float(i);
+}
@@ -0,0 +1,18 @@
+float unroll_locals(float s)
+{
+  float a[4];
+  float sum;
+  int i;
+
+  for (i = 0; i < 4; i++)
+    a[i] = s + float(i);
+
+  sum = 0.0;
+  for (i = 0; i < 4; i++)
+  {
+    float t = a[i];
+    sum += t;
+  }
+
+  return sum;
+}
@@ -0,0 +1,20 @@
+float update(float s)
+{
+  float a[3];
+  vec3 v = vec3(1.0, 2.0, 3.0);
+  float sum = 0.0;
+  int i;
+
+  a[0] = 1.0;
+  a[1] = 2.0;
+  a[2] = s;
+  for (i = 0; i < 3; i++)
+    sum += a[i] * a[i];
+
+  v.yz *= 2.0;
+  v.x++;
+  a[1]--;
+  ++a[2];
+
+  return sum + v.x + v.y + v.z + a[1] + a[2];
+}
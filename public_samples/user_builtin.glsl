@@ -0,0 +1,9 @@
+float mix(float a, float b, float t)
+{
+  return a + b + t;
+}
+
+float user_builtin(float x)
+{
+  return mix(1.0, 2.0, 0.5) + mix(x, 2.0 * x, 0.5);
+}
@@ -0,0 +1,16 @@
+float vec_index(int n)
+{
+  vec4 v = vec4(1.0, 2.0, 3.0, 4.0);
+  float s = 0.0;
+  int i;
+
+  for (i = 0; i < n; i++)
+  {
+    v[i] = v[i] * 10.0;
+    v[3 - i] += 1.0;
+    s += v[i];
+  }
+
+  v[n]++;
+  return s + v[n] + v[0];
+}
@@ -96,6 +96,11 @@ Symbol* SymbolTable::findInCurrentTable(const char *name)
 	return currentScopedTable->find(name);
 }
 
+Symbol* SymbolTable::findGlobal(const char *name)
+{
+	return tables.front()->find(name);
+}
+
 Type* SymbolTable::getCurrentFuncType()
 {
 	return currentFuncDecl->GetType();
@@ -133,11 +138,10 @@ llvm::Type* SymbolTable::GetType(llvm::Value *value)
 		//std::cerr << "symbol ConstantFP\n";
 		return irGen->GetFloatType();
 	}
-	else if(llvm::dyn_cast<llvm::GetElementPtrInst>(value))
+	else if(llvm::dyn_cast<llvm::GEPOperator>(value))
 	{
-		//std::cerr << "GetElemrntPtr in symbomTable\n";
-		llvm::GetElementPtrInst *elmt = llvm::dyn_cast<llvm::GetElementPtrInst>(value);
-		return elmt->getType()->getElementType();
+		//array element, folded to a constant expression for globals
+		return llvm::cast<llvm::PointerType>(value->getType())->getElementType();
 	}
 	else if(llvm::dyn_cast<llvm::ExtractElementInst>(value))
 	{
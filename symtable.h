@@ -94,6 +94,9 @@ class SymbolTable {
 	//Seach for symbol in current scoped table
 	Symbol *findInCurrentTable(const char *name);
 
+	//Search for symbol in the global table only, functions live there
+	Symbol *findGlobal(const char *name);
+
 	Type* getCurrentFuncType();
 
 	bool isGlobalScope() const { return (tables.size() == 1); }
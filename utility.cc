@@ -6,11 +6,14 @@
 
 #include "utility.h"
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include <vector>
 using std::vector;
 
 static vector<const char*> debugKeys;
+static vector<const char*> optionKeys;
+static vector<const char*> optionValues;
 static const int BufferSize = 2048;
 
 void Failure(const char *format, ...) {
@@ -58,19 +61,104 @@ void PrintDebug(const char *key, const char *format, ...) {
   printf("+++ (%s): %s%s", key, buf, buf[strlen(buf)-1] != '\n'? "\n" : "");
 }
 
-void ParseCommandLine(int argc, char *argv[]) {
-  if (argc == 1)
-    return;
-  
-  if (strcmp(argv[1], "-d") != 0) { // first arg is not -d
-    printf("Incorrect Use:   ");
-    for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
-    printf("\n");
-    printf("Correct Usage:   -d <debug-key-1> <debug-key-2> ... \n");
-    exit(2);
-  }
+static int IndexOfOption(const char *key) {
+  for (int i = optionKeys.size() - 1; i >= 0; i--)
+    if (!strcmp(optionKeys[i], key))
+      return i;
+
+  return -1;
+}
+
+void SetOption(const char *key, const char *value) {
+  optionKeys.push_back(key);
+  optionValues.push_back(value);
+}
+
+const char *GetOption(const char *key) {
+  int k = IndexOfOption(key);
+  return k == -1 ? NULL : optionValues[k];
+}
+
+int GetIntOption(const char *key, int defaultValue) {
+  const char *value = GetOption(key);
+  return value ? atoi(value) : defaultValue;
+}
+
+bool IsOptionOn(const char *key) {
+  return (IndexOfOption(key) != -1);
+}
 
-  for (int i = 2; i < argc; i++)
-    SetDebugForKey(argv[i], true);
+void PrintStat(const char *format, ...) {
+  va_list args;
+  char buf[BufferSize];
+
+  if (!IsOptionOn("stats"))
+     return;
+
+  va_start(args, format);
+  vsprintf(buf, format, args);
+  va_end(args);
+  fprintf(stderr, "+++ (stats): %s%s", buf, buf[strlen(buf)-1] != '\n'? "\n" : "");
 }
 
+static void Usage(int argc, char *argv[]) {
+  printf("Incorrect Use:   ");
+  for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
+  printf("\n");
+  printf("Correct Usage:   [-O0|-O1|-O2|-O3] [-passes=<p1,p2,...>] [-time-passes]\n");
+  printf("                 [-stats] [-f<flag> ...] [-specialize=<file>]\n");
+  printf("                 [-unroll-threshold=<n>] [-inline-threshold=<n>]\n");
+  printf("                 [-select-threshold=<n>]\n");
+  printf("                 [--entry <name> ...]\n");
+  printf("                 [-d <debug-key-1> <debug-key-2> ...]\n");
+  exit(2);
+}
+
+void ParseCommandLine(int argc, char *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+
+    if (!strcmp(arg, "-d")) {
+      // everything up to the next option is a debug key
+      while (i + 1 < argc && argv[i+1][0] != '-')
+        SetDebugForKey(argv[++i], true);
+    }
+    else if (!strncmp(arg, "-O", 2) && strlen(arg) == 3 && arg[2] >= '0' && arg[2] <= '3')
+      SetOption("O", arg + 2);
+    else if (!strncmp(arg, "-passes=", 8))
+      SetOption("passes", arg + 8);
+    else if (!strcmp(arg, "-time-passes"))
+      SetOption("time-passes", "");
+    else if (!strcmp(arg, "-stats"))
+      SetOption("stats", "");
+    else if (!strncmp(arg, "-specialize=", 12))
+      SetOption("specialize", arg + 12);
+    else if (!strncmp(arg, "-unroll-threshold=", 18))
+      SetOption("unroll-threshold", arg + 18);
+    else if (!strncmp(arg, "-inline-threshold=", 18))
+      SetOption("inline-threshold", arg + 18);
+    else if (!strncmp(arg, "-select-threshold=", 18))
+      SetOption("select-threshold", arg + 18);
+    else if (!strcmp(arg, "--entry")) {
+      if (i + 1 == argc) {
+        printf("--entry requires a function name\n");
+        Usage(argc, argv);
+      }
+
+      // repeatable, the names are kept comma separated
+      const char *prev = GetOption("entry");
+      const char *name = argv[++i];
+      if (prev == NULL)
+        SetOption("entry", name);
+      else {
+        char *entries = (char *)malloc(strlen(prev) + strlen(name) + 2);
+        sprintf(entries, "%s,%s", prev, name);
+        SetOption("entry", entries);
+      }
+    }
+    else if (!strncmp(arg, "-f", 2) && arg[2] != '\0')
+      SetOption(arg + 2, "");
+    else
+      Usage(argc, argv);
+  }
+}
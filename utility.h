@@ -73,12 +73,76 @@ void SetDebugForKey(const char *key, bool val);
 
 bool IsDebugOn(const char *key);
 
+/**
+ * Function: PrintStat()
+ * Usage: PrintStat("%d calls inlined", count);
+ * --------------------------------------------
+ * Print a statistics line from one of the passes if -stats was given.
+ * Statistics go to stderr since stdout carries the bitcode.
+ * The function accepts printf arguments.
+ */
+
+void PrintStat(const char *format, ...);
+
+/**
+ * Function: SetOption()
+ * Usage: SetOption("O", "2");
+ * ---------------------------
+ * Record the value of a compiler option.  Options are kept as key/value
+ * strings next to the debug keys; ParseCommandLine fills them in from
+ * the flags given to glc and the later phases query them by key.
+ */
+
+void SetOption(const char *key, const char *value);
+
+/**
+ * Function: GetOption()
+ * Usage: const char *passes = GetOption("passes");
+ * ------------------------------------------------
+ * Return the value recorded for the option, or NULL if it was never set.
+ */
+
+const char *GetOption(const char *key);
+
+/**
+ * Function: GetIntOption()
+ * Usage: int level = GetIntOption("O", 0);
+ * ----------------------------------------
+ * Return the value of the option converted to an integer, or the given
+ * default if the option was never set.
+ */
+
+int GetIntOption(const char *key, int defaultValue);
+
+/**
+ * Function: IsOptionOn()
+ * Usage: if (IsOptionOn("time-passes")) ...
+ * -----------------------------------------
+ * Return true/false based on whether the option was given at all.
+ */
+
+bool IsOptionOn(const char *key);
+
 /**
  * Function: ParseCommandLine
  * --------------------------
- * Turn on the debugging flags from the command line.  Verifies that
- * first argument is -d, and then interpret all the arguments that follow
- * as being flags to turn on.
+ * Interpret the glc command line.  -O0 .. -O3 select the optimization
+ * level, -passes=<p1,p2,...> replaces the default pass pipeline and
+ * -time-passes reports the time spent in each pass.  -stats turns on
+ * PrintStat and -f<flag> sets the code generation option <flag> (e.g.
+ * -fvolatile-stores, or -ffast-math and the finer -fcontract, -freassoc,
+ * -farcp, -fnnan, -fninf and -fdenormal-flush).  -specialize=<file> bakes the uniform values listed
+ * in <file> into the code (see SpecializeUniforms) and
+ * -unroll-threshold=<n> is the most iterations a counted for loop may
+ * have to be fully unrolled by the front end (0 turns it off), and
+ * -inline-threshold=<n> the size in instructions up to which a function
+ * is inlined into its callers (see InlineFunctions).  The right side of
+ * && and || and the arms of ?: are evaluated unconditionally when they
+ * have no side effects and cost at most -select-threshold=<n> (default
+ * 6), otherwise they are branched around.  --entry <name>
+ * (repeatable) compiles only what the named functions reach and gives
+ * everything else internal linkage.  The arguments that follow -d (up
+ * to the next option) are debugging flags to turn on.
  */
 
 void ParseCommandLine(int argc, char *argv[]);